@@ -0,0 +1,210 @@
+/*
+ * Copyright (c) 2011, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef INTERACTIVE_MARKER_TUTORIALS_AABB_KERNEL_H
+#define INTERACTIVE_MARKER_TUTORIALS_AABB_KERNEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <interactive_marker_tutorials/point_kd_tree.h>
+
+#if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) )
+#define INTERACTIVE_MARKER_TUTORIALS_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace interactive_marker_tutorials
+{
+
+// Box classification over points stored as separate x, y and z arrays.
+//
+// All kernels write one bit per point into mask, bit (i % 64) of word
+// (i / 64) being set if point i is inside the box.  The mask must hold
+// (n + 63) / 64 words; bits past n are cleared.  The SIMD variants are
+// compiled for their instruction set regardless of the compiler flags
+// and picked at runtime, so the same binary runs on any x86 CPU.
+enum AabbKernel
+{
+  AABB_KERNEL_SCALAR,
+  AABB_KERNEL_SSE,
+  AABB_KERNEL_AVX2
+};
+
+inline const char* aabbKernelName( AabbKernel kernel )
+{
+  switch ( kernel )
+  {
+  case AABB_KERNEL_SSE: return "sse";
+  case AABB_KERNEL_AVX2: return "avx2";
+  default: return "scalar";
+  }
+}
+
+inline bool aabbKernelSupported( AabbKernel kernel )
+{
+#ifdef INTERACTIVE_MARKER_TUTORIALS_X86_KERNELS
+  switch ( kernel )
+  {
+  case AABB_KERNEL_SSE: return __builtin_cpu_supports( "sse2" );
+  case AABB_KERNEL_AVX2: return __builtin_cpu_supports( "avx2" );
+  default: return true;
+  }
+#else
+  return kernel == AABB_KERNEL_SCALAR;
+#endif
+}
+
+// The fastest kernel the CPU we are running on supports.
+inline AabbKernel bestAabbKernel()
+{
+  static const AabbKernel best =
+      aabbKernelSupported( AABB_KERNEL_AVX2 ) ? AABB_KERNEL_AVX2 :
+      ( aabbKernelSupported( AABB_KERNEL_SSE ) ? AABB_KERNEL_SSE : AABB_KERNEL_SCALAR );
+  return best;
+}
+
+// Classify points [begin, n) one at a time, starting on a word boundary.
+inline void classifyAabbScalar( const float* x, const float* y, const float* z,
+                                size_t begin, size_t n, const Aabb& box, uint64_t* mask )
+{
+  for ( size_t word_begin=begin; word_begin<n; word_begin+=64 )
+  {
+    size_t word_end = word_begin + 64 < n ? word_begin + 64 : n;
+    uint64_t bits = 0;
+    for ( size_t i=word_begin; i<word_end; i++ )
+    {
+      uint64_t inside = ( box.min[0] <= x[i] ) & ( x[i] <= box.max[0] ) &
+                        ( box.min[1] <= y[i] ) & ( y[i] <= box.max[1] ) &
+                        ( box.min[2] <= z[i] ) & ( z[i] <= box.max[2] );
+      bits |= inside << ( i - word_begin );
+    }
+    mask[word_begin / 64] = bits;
+  }
+}
+
+#ifdef INTERACTIVE_MARKER_TUTORIALS_X86_KERNELS
+
+__attribute__(( target( "sse2" ) ))
+inline void classifyAabbSse( const float* x, const float* y, const float* z,
+                             size_t n, const Aabb& box, uint64_t* mask )
+{
+  const __m128 min_x = _mm_set1_ps( box.min[0] ), max_x = _mm_set1_ps( box.max[0] );
+  const __m128 min_y = _mm_set1_ps( box.min[1] ), max_y = _mm_set1_ps( box.max[1] );
+  const __m128 min_z = _mm_set1_ps( box.min[2] ), max_z = _mm_set1_ps( box.max[2] );
+
+  size_t full_words = n / 64;
+  for ( size_t w=0; w<full_words; w++ )
+  {
+    uint64_t bits = 0;
+    for ( size_t lane=0; lane<64; lane+=4 )
+    {
+      size_t i = w * 64 + lane;
+      __m128 px = _mm_loadu_ps( x + i );
+      __m128 py = _mm_loadu_ps( y + i );
+      __m128 pz = _mm_loadu_ps( z + i );
+      __m128 in = _mm_and_ps( _mm_cmple_ps( min_x, px ), _mm_cmple_ps( px, max_x ) );
+      in = _mm_and_ps( in, _mm_and_ps( _mm_cmple_ps( min_y, py ), _mm_cmple_ps( py, max_y ) ) );
+      in = _mm_and_ps( in, _mm_and_ps( _mm_cmple_ps( min_z, pz ), _mm_cmple_ps( pz, max_z ) ) );
+      bits |= (uint64_t)_mm_movemask_ps( in ) << lane;
+    }
+    mask[w] = bits;
+  }
+  classifyAabbScalar( x, y, z, full_words * 64, n, box, mask );
+}
+
+__attribute__(( target( "avx2" ) ))
+inline void classifyAabbAvx2( const float* x, const float* y, const float* z,
+                              size_t n, const Aabb& box, uint64_t* mask )
+{
+  const __m256 min_x = _mm256_set1_ps( box.min[0] ), max_x = _mm256_set1_ps( box.max[0] );
+  const __m256 min_y = _mm256_set1_ps( box.min[1] ), max_y = _mm256_set1_ps( box.max[1] );
+  const __m256 min_z = _mm256_set1_ps( box.min[2] ), max_z = _mm256_set1_ps( box.max[2] );
+
+  size_t full_words = n / 64;
+  for ( size_t w=0; w<full_words; w++ )
+  {
+    uint64_t bits = 0;
+    for ( size_t lane=0; lane<64; lane+=8 )
+    {
+      size_t i = w * 64 + lane;
+      __m256 px = _mm256_loadu_ps( x + i );
+      __m256 py = _mm256_loadu_ps( y + i );
+      __m256 pz = _mm256_loadu_ps( z + i );
+      __m256 in = _mm256_and_ps( _mm256_cmp_ps( min_x, px, _CMP_LE_OQ ), _mm256_cmp_ps( px, max_x, _CMP_LE_OQ ) );
+      in = _mm256_and_ps( in, _mm256_and_ps( _mm256_cmp_ps( min_y, py, _CMP_LE_OQ ), _mm256_cmp_ps( py, max_y, _CMP_LE_OQ ) ) );
+      in = _mm256_and_ps( in, _mm256_and_ps( _mm256_cmp_ps( min_z, pz, _CMP_LE_OQ ), _mm256_cmp_ps( pz, max_z, _CMP_LE_OQ ) ) );
+      bits |= (uint64_t)_mm256_movemask_ps( in ) << lane;
+    }
+    mask[w] = bits;
+  }
+  classifyAabbScalar( x, y, z, full_words * 64, n, box, mask );
+}
+
+#endif
+
+inline void classifyAabb( const float* x, const float* y, const float* z, size_t n,
+                          const Aabb& box, uint64_t* mask, AabbKernel kernel = bestAabbKernel() )
+{
+#ifdef INTERACTIVE_MARKER_TUTORIALS_X86_KERNELS
+  switch ( kernel )
+  {
+  case AABB_KERNEL_AVX2:
+    classifyAabbAvx2( x, y, z, n, box, mask );
+    return;
+  case AABB_KERNEL_SSE:
+    classifyAabbSse( x, y, z, n, box, mask );
+    return;
+  default:
+    break;
+  }
+#endif
+  classifyAabbScalar( x, y, z, 0, n, box, mask );
+}
+
+// An axis-aligned box as a volume for PointKdTree::classify(), like
+// OrientedBox and PolygonPrism in selection_volume.h.
+struct AabbVolume
+{
+  explicit AabbVolume( const Aabb& b ) : box( b ) {}
+
+  bool contains( const Aabb& other ) const { return box.contains( other ); }
+  bool overlaps( const Aabb& other ) const { return box.overlaps( other ); }
+
+  void classify( const float* x, const float* y, const float* z, size_t n, uint64_t* mask ) const
+  {
+    classifyAabb( x, y, z, n, box, mask );
+  }
+
+  Aabb box;
+};
+
+} // end namespace interactive_marker_tutorials
+
+#endif // INTERACTIVE_MARKER_TUTORIALS_AABB_KERNEL_H
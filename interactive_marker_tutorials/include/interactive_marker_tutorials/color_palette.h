@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 2011, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef INTERACTIVE_MARKER_TUTORIALS_COLOR_PALETTE_H
+#define INTERACTIVE_MARKER_TUTORIALS_COLOR_PALETTE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <std_msgs/ColorRGBA.h>
+
+namespace interactive_marker_tutorials
+{
+
+// Per-point marker colors from a scalar field, such as intensity or
+// height, through a lookup table.
+//
+// Mapping a field is two passes over blocks of points: one turns the
+// values into table indices, without branches or calls so that the
+// compiler vectorizes it, the other copies the table entries into the
+// colors of the marker.  colors is resized rather than rebuilt, so a
+// vector kept between updates doesn't allocate at all.  Classification
+// labels map one to one onto a palette with an entry per label and the
+// range [0, labels - 1].
+class ColorPalette
+{
+public:
+  // A table of size entries interpolated linearly between stops, which
+  // are spread evenly over the range.  With as many stops as entries,
+  // every stop is an entry.
+  ColorPalette( const std::vector<std_msgs::ColorRGBA>& stops, size_t size = 256 )
+  {
+    table_.resize( std::max<size_t>( size, 1 ) );
+    if ( stops.empty() )
+    {
+      return;
+    }
+    for ( size_t i=0; i<table_.size(); i++ )
+    {
+      float t = table_.size() > 1 ? (float)i / ( table_.size() - 1 ) * ( stops.size() - 1 ) : 0.0f;
+      size_t k = std::min( (size_t)t, stops.size() - 1 );
+      size_t next = std::min( k + 1, stops.size() - 1 );
+      float f = t - k;
+      table_[i].r = stops[k].r + f * ( stops[next].r - stops[k].r );
+      table_[i].g = stops[k].g + f * ( stops[next].g - stops[k].g );
+      table_[i].b = stops[k].b + f * ( stops[next].b - stops[k].b );
+      table_[i].a = stops[k].a + f * ( stops[next].a - stops[k].a );
+    }
+  }
+
+  // The palettes known by name: gray (black to white) and rainbow (blue
+  // over green to red).  False if name is none of them.
+  static bool byName( const std::string& name, std::vector<std_msgs::ColorRGBA>& stops )
+  {
+    static const float gray[][3] = { { 0, 0, 0 }, { 1, 1, 1 } };
+    static const float rainbow[][3] = { { 0, 0, 1 }, { 0, 1, 1 }, { 0, 1, 0 }, { 1, 1, 0 }, { 1, 0, 0 } };
+
+    const float (*rgb)[3];
+    size_t num_stops;
+    if ( name == "gray" )
+    {
+      rgb = gray;
+      num_stops = 2;
+    }
+    else if ( name == "rainbow" )
+    {
+      rgb = rainbow;
+      num_stops = 5;
+    }
+    else
+    {
+      return false;
+    }
+
+    stops.resize( num_stops );
+    for ( size_t i=0; i<num_stops; i++ )
+    {
+      stops[i].r = rgb[i][0];
+      stops[i].g = rgb[i][1];
+      stops[i].b = rgb[i][2];
+      stops[i].a = 1.0f;
+    }
+    return true;
+  }
+
+  size_t size() const { return table_.size(); }
+  const std_msgs::ColorRGBA& operator[]( size_t i ) const { return table_[i]; }
+
+  // Set colors to the color of field( i ) for i in [0, n), with min at
+  // the first entry of the table and max at the last.  Values outside
+  // the range get the end colors, NaNs the first.
+  template<class Field>
+  void map( const Field& field, size_t n, float min, float max,
+            std::vector<std_msgs::ColorRGBA>& colors ) const
+  {
+    const size_t block_size = 1024;
+    uint32_t index[block_size];
+
+    colors.resize( n );
+    for ( size_t begin=0; begin<n; begin+=block_size )
+    {
+      size_t count = std::min( block_size, n - begin );
+      indexBlock( field, begin, count, min, max, index );
+      std_msgs::ColorRGBA* out = &colors[begin];
+      for ( size_t k=0; k<count; k++ )
+      {
+        out[k] = table_[index[k]];
+      }
+    }
+  }
+
+  // Set indices to the table entries map() picks for field( i ), one
+  // byte per point instead of the 16 of a color, for a client that
+  // holds the table to look up.  False, leaving indices alone, if the
+  // table has more than 256 entries.
+  template<class Field>
+  bool index( const Field& field, size_t n, float min, float max,
+              std::vector<uint8_t>& indices ) const
+  {
+    if ( table_.size() > 256 )
+    {
+      return false;
+    }
+    indices.resize( n );
+    if ( n )
+    {
+      indexBlock( field, 0, n, min, max, indices.data() );
+    }
+    return true;
+  }
+
+  const std::vector<std_msgs::ColorRGBA>& table() const { return table_; }
+
+private:
+  // index[k] = the table entry of field( begin + k ) for k in [0, count),
+  // without branches or calls so that the compiler vectorizes it.
+  template<class Field, class Index>
+  void indexBlock( const Field& field, size_t begin, size_t count, float min, float max,
+                   Index* index ) const
+  {
+    float top = table_.size() - 1;
+    float scale = max > min ? top / ( max - min ) : 0.0f;
+    // rounding to the nearest entry is truncating half an entry later
+    float offset = 0.5f - min * scale;
+    for ( size_t k=0; k<count; k++ )
+    {
+      float t = field( begin + k ) * scale + offset;
+      // written so that NaN ends up at 0
+      t = t > 0.0f ? t : 0.0f;
+      t = t < top ? t : top;
+      index[k] = (Index)t;
+    }
+  }
+
+  std::vector<std_msgs::ColorRGBA> table_;
+};
+
+} // end namespace interactive_marker_tutorials
+
+#endif // INTERACTIVE_MARKER_TUTORIALS_COLOR_PALETTE_H
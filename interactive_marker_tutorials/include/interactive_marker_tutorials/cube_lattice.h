@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2011, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef INTERACTIVE_MARKER_TUTORIALS_CUBE_LATTICE_H
+#define INTERACTIVE_MARKER_TUTORIALS_CUBE_LATTICE_H
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <geometry_msgs/Point.h>
+#include <std_msgs/ColorRGBA.h>
+#include <visualization_msgs/InteractiveMarker.h>
+#include <visualization_msgs/Marker.h>
+
+namespace interactive_marker_tutorials
+{
+
+// The markers of the cube tutorial: a lattice of small cubes that can
+// be dragged in the view plane.  Shared with cube_benchmark.
+
+// Distance between neighbouring cubes.
+const float cube_lattice_step = 0.1f;
+
+// Where cube (ix, iy, iz) of a lattice of side_length^3 cubes starts.
+inline geometry_msgs::Point cubeLatticePoint( int side_length, int ix, int iy, int iz )
+{
+  float size = side_length * cube_lattice_step;
+  geometry_msgs::Point p;
+  p.x = -0.5*size + ix*cube_lattice_step;
+  p.y = -0.5*size + iy*cube_lattice_step;
+  p.z = iz*cube_lattice_step;
+  return p;
+}
+
+// The color of a cube that starts at p, in a lattice size across.
+inline std_msgs::ColorRGBA cubeColor( const geometry_msgs::Point& p, float size )
+{
+  std_msgs::ColorRGBA color;
+  color.r = 0.65+0.7*p.x/size;
+  color.g = 0.65+0.7*p.y/size;
+  color.b = 0.65+0.7*p.z/size;
+  color.a = 1.0;
+  return color;
+}
+
+inline visualization_msgs::InteractiveMarkerControl& makeBoxControl( visualization_msgs::InteractiveMarker &msg, float size )
+{
+  using visualization_msgs::InteractiveMarkerControl;
+  using visualization_msgs::Marker;
+
+  InteractiveMarkerControl control;
+  control.always_visible = true;
+  control.orientation_mode = InteractiveMarkerControl::VIEW_FACING;
+  control.interaction_mode = InteractiveMarkerControl::MOVE_PLANE;
+  control.independent_marker_orientation = true;
+
+  Marker marker;
+
+  marker.type = Marker::CUBE;
+  marker.scale.x = msg.scale;
+  marker.scale.y = msg.scale;
+  marker.scale.z = msg.scale;
+  marker.color = cubeColor( msg.pose.position, size );
+
+  control.markers.push_back( marker );
+  msg.controls.push_back( control );
+
+  return msg.controls.back();
+}
+
+// Make a cube of side_length^3 cubes, passing each cube to insert( marker )
+// as soon as it is made, so that no more than one is held at a time.  The
+// cubes are named by their index.
+template<class Insert>
+void makeCubeLattice( int side_length, Insert insert )
+{
+  float size = side_length * cube_lattice_step;
+  int count = 0;
+
+  for ( int ix=0; ix<side_length; ix++ )
+  {
+    for ( int iy=0; iy<side_length; iy++ )
+    {
+      for ( int iz=0; iz<side_length; iz++ )
+      {
+        visualization_msgs::InteractiveMarker int_marker;
+        int_marker.header.frame_id = "base_link";
+        int_marker.scale = cube_lattice_step;
+        int_marker.pose.position = cubeLatticePoint( side_length, ix, iy, iz );
+
+        int_marker.name = std::to_string( count );
+
+        makeBoxControl(int_marker, size);
+
+        insert( int_marker );
+
+        count++;
+      }
+    }
+  }
+}
+
+// Make the same cube of side_length^3 cubes as makeCubeLattice(), but
+// drawn as one CUBE_LIST marker per block of block_size^3 cubes instead
+// of one marker per cube.  Each block is passed to
+// insert( marker, cubes ) as soon as it is made, with the cube index of
+// each of its points.  The blocks are named by their index and start at
+// the origin.  Which cube is dragged has to be found from the mouse
+// point of the feedback.
+template<class Insert>
+void makeCubeLatticeBlocks( int side_length, int block_size, Insert insert )
+{
+  using visualization_msgs::InteractiveMarkerControl;
+  using visualization_msgs::Marker;
+
+  float size = side_length * cube_lattice_step;
+  int blocks = ( side_length + block_size - 1 ) / block_size;
+  std::vector<uint32_t> cubes;
+
+  for ( int b=0; b<blocks*blocks*blocks; b++ )
+  {
+    visualization_msgs::InteractiveMarker int_marker;
+    int_marker.header.frame_id = "base_link";
+    int_marker.scale = cube_lattice_step;
+    int_marker.pose.orientation.w = 1.0;
+    int_marker.name = std::to_string( b );
+
+    int_marker.controls.resize( 1 );
+    InteractiveMarkerControl& control = int_marker.controls[0];
+    control.always_visible = true;
+    control.orientation_mode = InteractiveMarkerControl::VIEW_FACING;
+    control.interaction_mode = InteractiveMarkerControl::MOVE_PLANE;
+    control.independent_marker_orientation = true;
+
+    control.markers.resize( 1 );
+    Marker& marker = control.markers[0];
+    marker.type = Marker::CUBE_LIST;
+    marker.pose.orientation.w = 1.0;
+    marker.scale.x = cube_lattice_step;
+    marker.scale.y = cube_lattice_step;
+    marker.scale.z = cube_lattice_step;
+
+    // the cubes of block (bx, by, bz), in the order of makeCubeLattice()
+    int bx = b / ( blocks*blocks ), by = b / blocks % blocks, bz = b % blocks;
+    cubes.clear();
+    for ( int ix=bx*block_size; ix<std::min( (bx+1)*block_size, side_length ); ix++ )
+    {
+      for ( int iy=by*block_size; iy<std::min( (by+1)*block_size, side_length ); iy++ )
+      {
+        for ( int iz=bz*block_size; iz<std::min( (bz+1)*block_size, side_length ); iz++ )
+        {
+          geometry_msgs::Point p = cubeLatticePoint( side_length, ix, iy, iz );
+          marker.points.push_back( p );
+          marker.colors.push_back( cubeColor( p, size ) );
+          cubes.push_back( ( ix*side_length + iy )*side_length + iz );
+        }
+      }
+    }
+
+    insert( int_marker, cubes );
+  }
+}
+
+} // end namespace interactive_marker_tutorials
+
+#endif // INTERACTIVE_MARKER_TUTORIALS_CUBE_LATTICE_H
@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2011, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef INTERACTIVE_MARKER_TUTORIALS_LATTICE_RELAXATION_H
+#define INTERACTIVE_MARKER_TUTORIALS_LATTICE_RELAXATION_H
+
+#include <stddef.h>
+
+#include <vector>
+
+#include <tf/LinearMath/Vector3.h>
+
+#include <interactive_marker_tutorials/worker_pool.h>
+
+namespace interactive_marker_tutorials
+{
+
+// A cubic lattice of nodes joined to their neighbours along each axis
+// by springs that pull them back to their rest offsets, relaxed
+// iteratively: the model of a deformable object that is held and
+// dragged at one node.  The bottom layer is fixed, as if the object
+// rested on a table.
+//
+// The springs only care about offsets, so the state is the displacement
+// of each node from rest, kept as separate x, y and z arrays of floats;
+// an iteration streams through all of them, and at 100^3 nodes is bound
+// by memory bandwidth rather than arithmetic.  Every iteration moves
+// each free node towards the mean displacement of its neighbours,
+// reading only the previous iteration (Jacobi), so the nodes are
+// independent and split across the pool in slabs of constant ix.  The
+// step is damped to 2/3 of the way, so that alternating patterns die
+// out instead of flipping back and forth.  A few iterations per frame
+// are enough, as every frame starts from the last.
+class LatticeRelaxation
+{
+public:
+  // side_length^3 nodes at rest, indexed (ix * side_length + iy) *
+  // side_length + iz as makeCubeLattice() lays them out.
+  LatticeRelaxation( int side_length, const std::vector<tf::Vector3>& rest ) :
+    side_( side_length ),
+    rest_( rest ),
+    grabbed_( -1 )
+  {
+    for ( int axis=0; axis<3; axis++ )
+    {
+      d_[axis].assign( rest.size(), 0.0f );
+      next_[axis].assign( rest.size(), 0.0f );
+    }
+  }
+
+  size_t size() const { return rest_.size(); }
+
+  // Hold node index at position until release() or the next grab().
+  void grab( size_t index, const tf::Vector3& position )
+  {
+    grabbed_ = index;
+    tf::Vector3 d = position - rest_[index];
+    target_[0] = d.x();
+    target_[1] = d.y();
+    target_[2] = d.z();
+  }
+
+  void release() { grabbed_ = -1; }
+
+  tf::Vector3 position( size_t i ) const
+  {
+    return tf::Vector3( rest_[i].x() + d_[0][i], rest_[i].y() + d_[1][i], rest_[i].z() + d_[2][i] );
+  }
+
+  // Run iterations of the relaxation, spread over pool.
+  void relax( WorkerPool& pool, int iterations )
+  {
+    for ( int n=0; n<iterations; n++ )
+    {
+      pool.parallelFor( side_, boost::bind( &LatticeRelaxation::relaxSlab, this, _1 ) );
+      for ( int axis=0; axis<3; axis++ )
+      {
+        d_[axis].swap( next_[axis] );
+      }
+    }
+  }
+
+private:
+  // Which neighbours a node has along ix and iy is the same for a whole
+  // row of iz, so the rows next to it are looked up once per row and the
+  // nodes in between the ends go through a loop without branches.
+  void relaxSlab( size_t ix )
+  {
+    const float damping = 2.0f / 3.0f;
+    const size_t side = side_;
+
+    for ( int axis=0; axis<3; axis++ )
+    {
+      const float* d = d_[axis].data();
+      float* next = next_[axis].data();
+      for ( size_t iy=0; iy<side; iy++ )
+      {
+        size_t row = ( ix * side + iy ) * side;
+        const float* r = d + row;
+        float* out = next + row;
+        const float* rows[4] = { r, r, r, r };
+        float num_rows = 0.0f;
+        if ( iy > 0 ) { rows[0] = r - side; num_rows++; }
+        if ( iy + 1 < side ) { rows[1] = r + side; num_rows++; }
+        if ( ix > 0 ) { rows[2] = r - side * side; num_rows++; }
+        if ( ix + 1 < side ) { rows[3] = r + side * side; num_rows++; }
+        // missing rows read the row itself, which the weight of the
+        // node itself takes out again
+        float self = 4.0f - num_rows;
+
+        // the bottom layer stays at rest
+        out[0] = 0.0f;
+        float inner = damping / ( num_rows + 2.0f );
+        for ( size_t iz=1; iz+1<side; iz++ )
+        {
+          float sum = r[iz - 1] + r[iz + 1] + rows[0][iz] + rows[1][iz] + rows[2][iz] + rows[3][iz] - self * r[iz];
+          out[iz] = r[iz] + inner * sum - damping * r[iz];
+        }
+        if ( side > 1 )
+        {
+          // the top layer has no neighbour above
+          size_t iz = side - 1;
+          float sum = r[iz - 1] + rows[0][iz] + rows[1][iz] + rows[2][iz] + rows[3][iz] - self * r[iz];
+          out[iz] = r[iz] + damping * ( sum / ( num_rows + 1.0f ) - r[iz] );
+        }
+      }
+      if ( grabbed_ >= 0 && (size_t)grabbed_ / ( side * side ) == ix )
+      {
+        next[grabbed_] = target_[axis];
+      }
+    }
+  }
+
+  size_t side_;
+  std::vector<tf::Vector3> rest_;
+  std::vector<float> d_[3];
+  std::vector<float> next_[3];
+
+  long grabbed_;
+  float target_[3];
+};
+
+} // end namespace interactive_marker_tutorials
+
+#endif // INTERACTIVE_MARKER_TUTORIALS_LATTICE_RELAXATION_H
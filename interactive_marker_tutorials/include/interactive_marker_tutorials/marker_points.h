@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2011, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef INTERACTIVE_MARKER_TUTORIALS_MARKER_POINTS_H
+#define INTERACTIVE_MARKER_TUTORIALS_MARKER_POINTS_H
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <geometry_msgs/Point.h>
+#include <visualization_msgs/Marker.h>
+
+#include <interactive_marker_tutorials/point_decimation.h>
+#include <interactive_marker_tutorials/worker_pool.h>
+
+namespace interactive_marker_tutorials
+{
+
+// Copy the given points of a cloud into the points of a marker.
+//
+// points is resized rather than rebuilt, so a vector that is kept
+// around between updates only allocates when it has to grow, and is
+// written in place by the pool.
+template<class Cloud>
+void fillMarkerPoints( WorkerPool& pool, const Cloud& cloud,
+                       const std::vector<uint32_t>& indices,
+                       std::vector<geometry_msgs::Point>& points )
+{
+  const size_t chunk_size = 65536;
+  size_t num_points = indices.size();
+  size_t num_chunks = ( num_points + chunk_size - 1 ) / chunk_size;
+
+  points.resize( num_points );
+  pool.parallelFor( num_chunks, [&]( size_t chunk )
+  {
+    size_t end = std::min( ( chunk + 1 ) * chunk_size, num_points );
+    for ( size_t i=chunk * chunk_size; i<end; i++ )
+    {
+      geometry_msgs::Point& p = points[i];
+      p.x = cloud.x( indices[i] );
+      p.y = cloud.y( indices[i] );
+      p.z = cloud.z( indices[i] );
+    }
+  } );
+}
+
+// Show the given points of a cloud in a sphere list marker.  More than
+// max_points points are decimated on a voxel grid first, with the
+// spheres grown to the cell size to cover the gaps; max_points 0 shows
+// all.  Points with a NaN or infinite coordinate, as organized clouds
+// mark missing returns, are always left out: RViz rejects a marker with
+// any of them.  decimated is scratch space kept by the caller.
+template<class Cloud>
+void updatePointMarker( WorkerPool& pool, const Cloud& cloud,
+                        const std::vector<uint32_t>& indices, size_t max_points,
+                        std::vector<uint32_t>& decimated, visualization_msgs::Marker& marker )
+{
+  float cell = decimateVoxelGrid( cloud, indices, max_points, decimated );
+  float scale = std::max( 0.05f, cell );
+  marker.scale.x = scale;
+  marker.scale.y = scale;
+  marker.scale.z = scale;
+
+  bool filtered = cell > 0 || dropNonFinite( cloud, indices, decimated );
+  fillMarkerPoints( pool, cloud, filtered ? decimated : indices, marker.points );
+}
+
+} // end namespace interactive_marker_tutorials
+
+#endif // INTERACTIVE_MARKER_TUTORIALS_MARKER_POINTS_H
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2011, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef INTERACTIVE_MARKER_TUTORIALS_PARALLEL_CLASSIFY_H
+#define INTERACTIVE_MARKER_TUTORIALS_PARALLEL_CLASSIFY_H
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <interactive_marker_tutorials/point_store.h>
+#include <interactive_marker_tutorials/worker_pool.h>
+
+namespace interactive_marker_tutorials
+{
+
+// Chunks are made of whole mask words, so that every chunk writes its
+// own part of the mask.  A few chunks per thread even out the load,
+// but each one is at least 64k points to keep the overhead small.
+inline size_t maskWordsPerChunk( const WorkerPool& pool, size_t num_words )
+{
+  size_t target = ( num_words + 4 * pool.size() - 1 ) / ( 4 * pool.size() );
+  return std::max( target, (size_t)1024 );
+}
+
+// Classify all points into mask, spread over the pool.  Points can be
+// any point source with size() and a classify( begin, end, box, mask )
+// method for ranges starting on a word boundary, like PointStore.
+template<class Points>
+void classifyParallel( WorkerPool& pool, const Points& points, const Aabb& box,
+                       std::vector<uint64_t>& mask )
+{
+  size_t num_points = points.size();
+  size_t num_words = ( num_points + 63 ) / 64;
+  size_t chunk_words = maskWordsPerChunk( pool, num_words );
+  size_t num_chunks = ( num_words + chunk_words - 1 ) / chunk_words;
+  mask.resize( num_words );
+
+  pool.parallelFor( num_chunks, [&]( size_t chunk )
+  {
+    size_t begin = chunk * chunk_words * 64;
+    size_t end = std::min( begin + chunk_words * 64, num_points );
+    points.classify( begin, end, box, mask.data() + begin / 64 );
+  } );
+}
+
+// Turn a mask over num_points points into the index lists of the
+// points inside and outside.  Each chunk first counts its selected
+// points; a prefix sum over the counts then gives every chunk its
+// offset in both outputs, so the chunks fill them in place concurrently
+// instead of being concatenated afterwards.
+inline void splitByMask( WorkerPool& pool, const std::vector<uint64_t>& mask, size_t num_points,
+                         std::vector<uint32_t>& inside, std::vector<uint32_t>& outside )
+{
+  size_t num_words = ( num_points + 63 ) / 64;
+  size_t chunk_words = maskWordsPerChunk( pool, num_words );
+  size_t num_chunks = ( num_words + chunk_words - 1 ) / chunk_words;
+
+  std::vector<size_t> in_offsets( num_chunks + 1, 0 );
+  pool.parallelFor( num_chunks, [&]( size_t chunk )
+  {
+    size_t end = std::min( ( chunk + 1 ) * chunk_words, num_words );
+    size_t count = 0;
+    for ( size_t w=chunk * chunk_words; w<end; w++ )
+    {
+      count += __builtin_popcountll( mask[w] );
+    }
+    in_offsets[chunk + 1] = count;
+  } );
+  for ( size_t chunk=0; chunk<num_chunks; chunk++ )
+  {
+    in_offsets[chunk + 1] += in_offsets[chunk];
+  }
+
+  inside.resize( in_offsets[num_chunks] );
+  outside.resize( num_points - in_offsets[num_chunks] );
+
+  pool.parallelFor( num_chunks, [&]( size_t chunk )
+  {
+    size_t end = std::min( ( chunk + 1 ) * chunk_words, num_words );
+    uint32_t* in = inside.data() + in_offsets[chunk];
+    // everything before this chunk that isn't inside is outside
+    uint32_t* out = outside.data() + ( chunk * chunk_words * 64 - in_offsets[chunk] );
+
+    for ( size_t w=chunk * chunk_words; w<end; w++ )
+    {
+      uint32_t base = w * 64;
+      uint64_t valid = num_points - base >= 64 ? ~(uint64_t)0 : ( (uint64_t)1 << ( num_points - base ) ) - 1;
+      uint64_t bits = mask[w];
+      uint64_t rest = ~bits & valid;
+      while ( bits )
+      {
+        *in++ = base + __builtin_ctzll( bits );
+        bits &= bits - 1;
+      }
+      while ( rest )
+      {
+        *out++ = base + __builtin_ctzll( rest );
+        rest &= rest - 1;
+      }
+    }
+  } );
+}
+
+} // end namespace interactive_marker_tutorials
+
+#endif // INTERACTIVE_MARKER_TUTORIALS_PARALLEL_CLASSIFY_H
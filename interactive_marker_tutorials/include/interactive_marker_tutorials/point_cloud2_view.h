@@ -0,0 +1,168 @@
+/*
+ * Copyright (c) 2011, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef INTERACTIVE_MARKER_TUTORIALS_POINT_CLOUD2_VIEW_H
+#define INTERACTIVE_MARKER_TUTORIALS_POINT_CLOUD2_VIEW_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include <sensor_msgs/PointCloud2.h>
+
+#include <interactive_marker_tutorials/aabb_kernel.h>
+
+namespace interactive_marker_tutorials
+{
+
+// The points of a sensor_msgs/PointCloud2 message, read in place from
+// its data buffer.
+//
+// The view keeps a reference to the message, so the buffer stays valid
+// as long as the view does.  Only clouds with float32 x, y and z fields
+// in host byte order are supported.  Usable as the cloud argument of
+// PointKdTree and the point source of the selection tools.
+class PointCloud2View
+{
+public:
+  PointCloud2View() :
+    data_( 0 ), num_points_( 0 ), width_( 1 ), point_step_( 0 ), row_step_( 0 ), dense_rows_( true )
+  {
+    offsets_[0] = offsets_[1] = offsets_[2] = 0;
+  }
+
+  // Returns false if the cloud doesn't have the fields we need, leaving
+  // the view empty.
+  bool assign( const sensor_msgs::PointCloud2ConstPtr& cloud )
+  {
+    *this = PointCloud2View();
+    if ( !cloud || cloud->is_bigendian || cloud->width == 0 )
+    {
+      return false;
+    }
+
+    const char* names[3] = { "x", "y", "z" };
+    for ( int axis=0; axis<3; axis++ )
+    {
+      bool found = false;
+      for ( size_t i=0; i<cloud->fields.size(); i++ )
+      {
+        const sensor_msgs::PointField& field = cloud->fields[i];
+        if ( field.name == names[axis] && field.datatype == sensor_msgs::PointField::FLOAT32 &&
+             field.offset + sizeof( float ) <= cloud->point_step )
+        {
+          offsets_[axis] = field.offset;
+          found = true;
+        }
+      }
+      if ( !found )
+      {
+        return false;
+      }
+    }
+
+    if ( cloud->row_step < cloud->width * cloud->point_step ||
+         cloud->data.size() < (size_t)cloud->height * cloud->row_step )
+    {
+      return false;
+    }
+
+    cloud_ = cloud;
+    data_ = cloud->data.data();
+    num_points_ = (size_t)cloud->width * cloud->height;
+    width_ = cloud->width;
+    point_step_ = cloud->point_step;
+    row_step_ = cloud->row_step;
+    dense_rows_ = row_step_ == width_ * point_step_;
+    return true;
+  }
+
+  const sensor_msgs::PointCloud2ConstPtr& cloud() const { return cloud_; }
+
+  size_t size() const { return num_points_; }
+  float x( size_t i ) const { return field( i, offsets_[0] ); }
+  float y( size_t i ) const { return field( i, offsets_[1] ); }
+  float z( size_t i ) const { return field( i, offsets_[2] ); }
+
+  // Classify points [begin, end) into mask, which points at the word of
+  // point begin (a multiple of 64).  Like MappedPointFile, the points
+  // are split into x, y and z in small blocks on the stack for the box
+  // kernel.
+  void classify( size_t begin, size_t end, const Aabb& box, uint64_t* mask ) const
+  {
+    const size_t block_size = 1024;
+    float x[block_size], y[block_size], z[block_size];
+
+    for ( size_t block=begin; block<end; block+=block_size )
+    {
+      size_t count = std::min( block_size, end - block );
+      for ( size_t i=0; i<count; i++ )
+      {
+        const uint8_t* p = point( block + i );
+        memcpy( &x[i], p + offsets_[0], sizeof( float ) );
+        memcpy( &y[i], p + offsets_[1], sizeof( float ) );
+        memcpy( &z[i], p + offsets_[2], sizeof( float ) );
+      }
+      classifyAabb( x, y, z, count, box, mask + ( block - begin ) / 64 );
+    }
+  }
+
+private:
+  const uint8_t* point( size_t i ) const
+  {
+    if ( dense_rows_ )
+    {
+      return data_ + i * point_step_;
+    }
+    return data_ + ( i / width_ ) * row_step_ + ( i % width_ ) * point_step_;
+  }
+
+  // fields need not be aligned, memcpy compiles to a plain load
+  float field( size_t i, uint32_t offset ) const
+  {
+    float value;
+    memcpy( &value, point( i ) + offset, sizeof( float ) );
+    return value;
+  }
+
+  sensor_msgs::PointCloud2ConstPtr cloud_;
+  const uint8_t* data_;
+  size_t num_points_;
+  size_t width_;
+  size_t point_step_;
+  size_t row_step_;
+  // rows follow each other without padding
+  bool dense_rows_;
+  uint32_t offsets_[3];
+};
+
+} // end namespace interactive_marker_tutorials
+
+#endif // INTERACTIVE_MARKER_TUTORIALS_POINT_CLOUD2_VIEW_H
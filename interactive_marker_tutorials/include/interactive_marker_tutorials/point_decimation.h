@@ -0,0 +1,211 @@
+/*
+ * Copyright (c) 2011, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef INTERACTIVE_MARKER_TUTORIALS_POINT_DECIMATION_H
+#define INTERACTIVE_MARKER_TUTORIALS_POINT_DECIMATION_H
+
+#include <math.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_set>
+#include <vector>
+
+#include <interactive_marker_tutorials/point_kd_tree.h>
+
+namespace interactive_marker_tutorials
+{
+
+template<class Cloud>
+bool isFinitePoint( const Cloud& cloud, uint32_t p )
+{
+  return std::isfinite( cloud.x( p ) ) && std::isfinite( cloud.y( p ) ) && std::isfinite( cloud.z( p ) );
+}
+
+// Set finite to the points of indices without a NaN or infinite
+// coordinate and return true, or return false and leave finite alone if
+// all of them are finite, so the common case copies nothing.
+template<class Cloud>
+bool dropNonFinite( const Cloud& cloud, const std::vector<uint32_t>& indices,
+                    std::vector<uint32_t>& finite )
+{
+  size_t first = 0;
+  while ( first < indices.size() && isFinitePoint( cloud, indices[first] ) )
+  {
+    first++;
+  }
+  if ( first == indices.size() )
+  {
+    return false;
+  }
+
+  finite.assign( indices.begin(), indices.begin() + first );
+  for ( size_t i=first + 1; i<indices.size(); i++ )
+  {
+    if ( isFinitePoint( cloud, indices[i] ) )
+    {
+      finite.push_back( indices[i] );
+    }
+  }
+  return true;
+}
+
+// Thin out a subset of a cloud to at most budget points for display,
+// keeping the first point in every cell of a voxel grid.
+//
+// The cell size starts at the size that would spread budget points over
+// the two largest extents of the subset (most scans are surfaces) and
+// grows until no more than budget cells are occupied.  Points with a
+// NaN or infinite coordinate have no cell and are dropped.  Returns the cell
+// size used, or 0 if the subset already fits; decimated is then left
+// empty rather than made a copy of indices, and the caller shows
+// indices as they are.
+template<class Cloud>
+float decimateVoxelGrid( const Cloud& cloud, const std::vector<uint32_t>& indices, size_t budget,
+                         std::vector<uint32_t>& decimated )
+{
+  decimated.clear();
+  if ( budget == 0 || indices.size() <= budget )
+  {
+    return 0.0f;
+  }
+
+  Aabb bounds;
+  for ( size_t i=0; i<indices.size(); i++ )
+  {
+    uint32_t p = indices[i];
+    if ( isFinitePoint( cloud, p ) )
+    {
+      bounds.extend( cloud.x( p ), cloud.y( p ), cloud.z( p ) );
+    }
+  }
+  float extent[3];
+  for ( int axis=0; axis<3; axis++ )
+  {
+    extent[axis] = std::max( bounds.max[axis] - bounds.min[axis], 1e-6f );
+  }
+  std::sort( extent, extent + 3 );
+  // cell coordinates are packed into 21 bits each
+  float cell = std::max( sqrtf( extent[1] * extent[2] / budget ), extent[2] / 1000000.0f );
+
+  std::unordered_set<uint64_t> cells;
+  cells.reserve( 2 * budget );
+  for ( int attempt=0; attempt<32; attempt++, cell *= 1.25f )
+  {
+    decimated.clear();
+    cells.clear();
+    float inv_cell = 1.0f / cell;
+
+    for ( size_t i=0; i<indices.size() && decimated.size()<=budget; i++ )
+    {
+      uint32_t p = indices[i];
+      if ( !isFinitePoint( cloud, p ) ) continue;
+      uint64_t cx = ( cloud.x( p ) - bounds.min[0] ) * inv_cell;
+      uint64_t cy = ( cloud.y( p ) - bounds.min[1] ) * inv_cell;
+      uint64_t cz = ( cloud.z( p ) - bounds.min[2] ) * inv_cell;
+      if ( cells.insert( ( cx << 42 ) | ( cy << 21 ) | cz ).second )
+      {
+        decimated.push_back( p );
+      }
+    }
+
+    if ( decimated.size() <= budget )
+    {
+      return cell;
+    }
+  }
+
+  // only reached for degenerate input, fall back to a regular stride
+  decimated.clear();
+  size_t stride = ( indices.size() + budget - 1 ) / budget;
+  for ( size_t i=0; i<indices.size(); i+=stride )
+  {
+    if ( isFinitePoint( cloud, indices[i] ) )
+    {
+      decimated.push_back( indices[i] );
+    }
+  }
+  return cell;
+}
+
+// Thin out the points whose bit in mask is set (or clear, with
+// selected false) to at most budget points, taking every stride-th one
+// in index order.  Streams over the mask instead of building the index
+// list of the whole subset, so for point sources that don't fit in
+// memory only the sampled indices are allocated.  A budget of 0 takes
+// all points.  Returns the stride, 1 if no point was left out.
+inline size_t sampleMask( const std::vector<uint64_t>& mask, size_t num_points, bool selected,
+                          size_t budget, std::vector<uint32_t>& sampled )
+{
+  size_t num_words = ( num_points + 63 ) / 64;
+  size_t count = 0;
+  for ( size_t w=0; w<num_words; w++ )
+  {
+    count += __builtin_popcountll( mask[w] );
+  }
+  if ( !selected )
+  {
+    count = num_points - count;
+  }
+  size_t stride = budget == 0 || count <= budget ? 1 : ( count + budget - 1 ) / budget;
+
+  sampled.clear();
+  sampled.reserve( ( count + stride - 1 ) / stride );
+  // matching points to pass over before the next one is taken
+  size_t skip = 0;
+  for ( size_t w=0; w<num_words; w++ )
+  {
+    uint64_t bits = selected ? mask[w] : ~mask[w];
+    if ( num_points - w * 64 < 64 )
+    {
+      bits &= ( (uint64_t)1 << ( num_points - w * 64 ) ) - 1;
+    }
+    size_t n = __builtin_popcountll( bits );
+    if ( skip >= n )
+    {
+      skip -= n;
+      continue;
+    }
+    for ( ; bits; bits &= bits - 1 )
+    {
+      if ( skip == 0 )
+      {
+        sampled.push_back( w * 64 + __builtin_ctzll( bits ) );
+        skip = stride;
+      }
+      skip--;
+    }
+  }
+  return stride;
+}
+
+} // end namespace interactive_marker_tutorials
+
+#endif // INTERACTIVE_MARKER_TUTORIALS_POINT_DECIMATION_H
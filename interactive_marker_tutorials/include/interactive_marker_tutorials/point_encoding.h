@@ -0,0 +1,379 @@
+/*
+ * Copyright (c) 2011, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef INTERACTIVE_MARKER_TUTORIALS_POINT_ENCODING_H
+#define INTERACTIVE_MARKER_TUTORIALS_POINT_ENCODING_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <geometry_msgs/Point.h>
+#include <roslz4/lz4s.h>
+#include <std_msgs/ColorRGBA.h>
+#include <visualization_msgs/Marker.h>
+
+#include <interactive_marker_tutorials/PointChunk.h>
+
+namespace interactive_marker_tutorials
+{
+
+// Compact transport of marker points, see msg/PointChunk.msg.
+//
+// A Marker serializes 24 bytes per point.  FLOAT32 halves that, at
+// about 1e-7 relative error, INT16 quarters it, at half a step of
+// error: 1/131070 of the extent of a chunk along each axis.
+//
+// The data is stored in byte planes: byte 0 of the x of every point,
+// then byte 1, and so on for y and z, least significant first.  This
+// keeps bytes that change slowly from point to point, like exponents
+// and high bytes, together where LZ4 finds them: a 1M point helix of
+// the point_cloud tutorial compresses to 0.7 bytes per point in INT16
+// and 1.2 in FLOAT32, against 5.6 and 12 with the bytes of a value
+// together.  Points in random order don't compress.
+// The layout is also independent of byte order.
+//
+// Per-point colors of a palette go as a byte per point after the
+// coordinates, an index into the palette of the chunk, instead of the
+// 16 bytes of a color in the sub-marker.
+
+// Store value as byte i of n planes of one byte each, starting at plane.
+inline void storePlanes( uint16_t value, uint8_t* plane, size_t i, size_t n )
+{
+  plane[i] = value;
+  plane[n + i] = value >> 8;
+}
+
+inline void storePlanes( float value, uint8_t* plane, size_t i, size_t n )
+{
+  uint32_t bits;
+  memcpy( &bits, &value, sizeof( bits ) );
+  plane[i] = bits;
+  plane[n + i] = bits >> 8;
+  plane[2 * n + i] = bits >> 16;
+  plane[3 * n + i] = bits >> 24;
+}
+
+inline uint16_t loadPlanes16( const uint8_t* plane, size_t i, size_t n )
+{
+  return plane[i] | plane[n + i] << 8;
+}
+
+inline float loadPlanes32( const uint8_t* plane, size_t i, size_t n )
+{
+  uint32_t bits = (uint32_t)plane[i] | (uint32_t)plane[n + i] << 8 |
+                  (uint32_t)plane[2 * n + i] << 16 | (uint32_t)plane[3 * n + i] << 24;
+  float value;
+  memcpy( &value, &bits, sizeof( value ) );
+  return value;
+}
+
+// Bytes per point of an encoding, before compression.
+inline size_t encodedPointSize( uint8_t encoding )
+{
+  return encoding == PointChunk::INT16 ? 3 * sizeof( uint16_t ) : 3 * sizeof( float );
+}
+
+// Encode n points into chunk.data, setting num_points, encoding, origin,
+// step, compression and raw_size.  Compression is dropped if it doesn't
+// make the data smaller.  color_indices, if given, are n palette
+// indices stored after the coordinates; the caller sets the palette.
+inline void encodePoints( const geometry_msgs::Point* points, size_t n,
+                          uint8_t encoding, bool compress, PointChunk& chunk,
+                          const uint8_t* color_indices = 0 )
+{
+  chunk.num_points = n;
+  chunk.encoding = encoding;
+  chunk.compression = PointChunk::NONE;
+  size_t points_size = n * encodedPointSize( encoding );
+  chunk.raw_size = points_size + ( color_indices ? n : 0 );
+
+  std::vector<uint8_t> raw;
+  std::vector<uint8_t>& out = compress ? raw : chunk.data;
+  out.resize( chunk.raw_size );
+
+  if ( encoding == PointChunk::INT16 )
+  {
+    geometry_msgs::Point lo, hi;
+    if ( n )
+    {
+      lo = hi = points[0];
+    }
+    for ( size_t i=1; i<n; i++ )
+    {
+      lo.x = std::min( lo.x, points[i].x );
+      lo.y = std::min( lo.y, points[i].y );
+      lo.z = std::min( lo.z, points[i].z );
+      hi.x = std::max( hi.x, points[i].x );
+      hi.y = std::max( hi.y, points[i].y );
+      hi.z = std::max( hi.z, points[i].z );
+    }
+    chunk.origin = lo;
+    chunk.step.x = hi.x > lo.x ? ( hi.x - lo.x ) / 65535.0 : 1.0;
+    chunk.step.y = hi.y > lo.y ? ( hi.y - lo.y ) / 65535.0 : 1.0;
+    chunk.step.z = hi.z > lo.z ? ( hi.z - lo.z ) / 65535.0 : 1.0;
+
+    // every point lies within the box, so rounding stays within 65535
+    double scale_x = 1.0 / chunk.step.x;
+    double scale_y = 1.0 / chunk.step.y;
+    double scale_z = 1.0 / chunk.step.z;
+    uint8_t* x = out.data();
+    uint8_t* y = x + 2 * n;
+    uint8_t* z = y + 2 * n;
+    for ( size_t i=0; i<n; i++ )
+    {
+      storePlanes( (uint16_t)( ( points[i].x - lo.x ) * scale_x + 0.5 ), x, i, n );
+      storePlanes( (uint16_t)( ( points[i].y - lo.y ) * scale_y + 0.5 ), y, i, n );
+      storePlanes( (uint16_t)( ( points[i].z - lo.z ) * scale_z + 0.5 ), z, i, n );
+    }
+  }
+  else
+  {
+    uint8_t* x = out.data();
+    uint8_t* y = x + 4 * n;
+    uint8_t* z = y + 4 * n;
+    for ( size_t i=0; i<n; i++ )
+    {
+      storePlanes( (float)points[i].x, x, i, n );
+      storePlanes( (float)points[i].y, y, i, n );
+      storePlanes( (float)points[i].z, z, i, n );
+    }
+    chunk.origin = geometry_msgs::Point();
+    chunk.step = geometry_msgs::Vector3();
+  }
+  if ( color_indices && n )
+  {
+    memcpy( out.data() + points_size, color_indices, n );
+  }
+
+  if ( compress && !raw.empty() )
+  {
+    // LZ4 grows incompressible data by 1/255, plus the stream framing
+    unsigned int size = raw.size() + raw.size() / 255 + 64 * ( raw.size() / 65536 + 1 );
+    chunk.data.resize( size );
+    int result = roslz4_buffToBuffCompress( reinterpret_cast<char*>( raw.data() ), raw.size(),
+                                            reinterpret_cast<char*>( chunk.data.data() ), &size, 6 );
+    if ( result == ROSLZ4_OK && size < raw.size() )
+    {
+      chunk.data.resize( size );
+      chunk.compression = PointChunk::LZ4;
+    }
+    else
+    {
+      chunk.data.swap( raw );
+    }
+  }
+  else if ( compress )
+  {
+    chunk.data.clear();
+  }
+}
+
+// Decode the points of a chunk into points, and if the chunk has a
+// palette and colors is given, their colors into colors.  False if the
+// chunk is malformed.
+inline bool decodePoints( const PointChunk& chunk, std::vector<geometry_msgs::Point>& points,
+                          std::vector<std_msgs::ColorRGBA>* colors = 0 )
+{
+  size_t n = chunk.num_points;
+  size_t points_size = n * encodedPointSize( chunk.encoding );
+  if ( chunk.encoding > PointChunk::INT16 ||
+       chunk.raw_size != points_size + ( chunk.palette.empty() ? 0 : n ) )
+  {
+    return false;
+  }
+
+  const uint8_t* data = chunk.data.data();
+  std::vector<uint8_t> raw;
+  if ( chunk.compression == PointChunk::LZ4 )
+  {
+    raw.resize( chunk.raw_size );
+    unsigned int size = raw.size();
+    int result = roslz4_buffToBuffDecompress( const_cast<char*>( reinterpret_cast<const char*>( data ) ),
+                                              chunk.data.size(),
+                                              reinterpret_cast<char*>( raw.data() ), &size );
+    if ( result != ROSLZ4_OK || size != raw.size() )
+    {
+      return false;
+    }
+    data = raw.data();
+  }
+  else if ( chunk.compression != PointChunk::NONE || chunk.data.size() != chunk.raw_size )
+  {
+    return false;
+  }
+
+  points.resize( n );
+  if ( chunk.encoding == PointChunk::INT16 )
+  {
+    const uint8_t* x = data;
+    const uint8_t* y = x + 2 * n;
+    const uint8_t* z = y + 2 * n;
+    for ( size_t i=0; i<n; i++ )
+    {
+      points[i].x = chunk.origin.x + loadPlanes16( x, i, n ) * chunk.step.x;
+      points[i].y = chunk.origin.y + loadPlanes16( y, i, n ) * chunk.step.y;
+      points[i].z = chunk.origin.z + loadPlanes16( z, i, n ) * chunk.step.z;
+    }
+  }
+  else
+  {
+    const uint8_t* x = data;
+    const uint8_t* y = x + 4 * n;
+    const uint8_t* z = y + 4 * n;
+    for ( size_t i=0; i<n; i++ )
+    {
+      points[i].x = loadPlanes32( x, i, n );
+      points[i].y = loadPlanes32( y, i, n );
+      points[i].z = loadPlanes32( z, i, n );
+    }
+  }
+
+  if ( colors && !chunk.palette.empty() )
+  {
+    const uint8_t* index = data + points_size;
+    size_t top = chunk.palette.size() - 1;
+    colors->resize( n );
+    for ( size_t i=0; i<n; i++ )
+    {
+      ( *colors )[i] = chunk.palette[std::min<size_t>( index[i], top )];
+    }
+  }
+  return true;
+}
+
+// The points of a marker type that belong together: the ends of a line
+// of a LINE_LIST and the corners of a triangle of a TRIANGLE_LIST.  RViz
+// rejects a marker whose point count isn't a multiple of this.
+inline size_t markerPointGroup( int32_t type )
+{
+  if ( type == visualization_msgs::Marker::LINE_LIST )
+  {
+    return 2;
+  }
+  if ( type == visualization_msgs::Marker::TRIANGLE_LIST )
+  {
+    return 3;
+  }
+  return 1;
+}
+
+// Split a marker into chunks of at most max_chunk_bytes of encoded
+// points each, before compression.  The sub-markers keep the namespace
+// of the marker and are numbered by chunk from id 0, so that sending
+// them again replaces them.
+//
+// Chunk boundaries keep the lines of a LINE_LIST and the triangles of a
+// TRIANGLE_LIST together, and consecutive chunks of a LINE_STRIP share
+// a point, so the strip stays connected.
+//
+// If color_indices has an entry per point, the points are colored by
+// those entries of palette, sent along with every chunk, and the colors
+// of marker are left out.
+inline void encodeMarker( const visualization_msgs::Marker& marker,
+                          uint8_t encoding, bool compress, size_t max_chunk_bytes,
+                          const std::vector<std_msgs::ColorRGBA>& palette,
+                          const std::vector<uint8_t>& color_indices,
+                          std::vector<PointChunk>& chunks )
+{
+  size_t num_points = marker.points.size();
+  bool indexed = !palette.empty() && color_indices.size() == num_points;
+
+  size_t group = markerPointGroup( marker.type );
+  size_t point_size = encodedPointSize( encoding ) + ( indexed ? 1 : 0 );
+  size_t chunk_points = max_chunk_bytes / point_size / group * group;
+  chunk_points = std::max( chunk_points, std::max<size_t>( group, 2 ) );
+  size_t overlap = marker.type == visualization_msgs::Marker::LINE_STRIP ? 1 : 0;
+
+  size_t num_chunks = num_points <= chunk_points ? 1 :
+      ( num_points - overlap + chunk_points - overlap - 1 ) / ( chunk_points - overlap );
+  chunks.resize( num_chunks );
+
+  for ( size_t c=0; c<num_chunks; c++ )
+  {
+    size_t begin = c * ( chunk_points - overlap );
+    size_t end = std::min( begin + chunk_points, num_points );
+
+    PointChunk& chunk = chunks[c];
+    visualization_msgs::Marker& sub_marker = chunk.marker;
+    sub_marker.header = marker.header;
+    sub_marker.ns = marker.ns;
+    sub_marker.id = c;
+    sub_marker.type = marker.type;
+    sub_marker.action = marker.action;
+    sub_marker.pose = marker.pose;
+    sub_marker.scale = marker.scale;
+    sub_marker.color = marker.color;
+    sub_marker.lifetime = marker.lifetime;
+    sub_marker.frame_locked = marker.frame_locked;
+    sub_marker.points.clear();
+    if ( !indexed && marker.colors.size() == num_points )
+    {
+      sub_marker.colors.assign( marker.colors.begin() + begin, marker.colors.begin() + end );
+    }
+    else
+    {
+      sub_marker.colors.clear();
+    }
+
+    chunk.first_point = begin;
+    if ( indexed )
+    {
+      chunk.palette = palette;
+      encodePoints( marker.points.data() + begin, end - begin, encoding, compress, chunk,
+                    color_indices.data() + begin );
+    }
+    else
+    {
+      chunk.palette.clear();
+      encodePoints( marker.points.data() + begin, end - begin, encoding, compress, chunk );
+    }
+  }
+}
+
+inline void encodeMarker( const visualization_msgs::Marker& marker,
+                          uint8_t encoding, bool compress, size_t max_chunk_bytes,
+                          std::vector<PointChunk>& chunks )
+{
+  encodeMarker( marker, encoding, compress, max_chunk_bytes,
+                std::vector<std_msgs::ColorRGBA>(), std::vector<uint8_t>(), chunks );
+}
+
+// The sub-marker of a chunk, with its points and colors decoded.  False
+// if the chunk is malformed.
+inline bool decodeMarker( const PointChunk& chunk, visualization_msgs::Marker& marker )
+{
+  marker = chunk.marker;
+  return decodePoints( chunk, marker.points, &marker.colors );
+}
+
+} // end namespace interactive_marker_tutorials
+
+#endif // INTERACTIVE_MARKER_TUTORIALS_POINT_ENCODING_H
@@ -0,0 +1,243 @@
+/*
+ * Copyright (c) 2011, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef INTERACTIVE_MARKER_TUTORIALS_POINT_FILE_H
+#define INTERACTIVE_MARKER_TUTORIALS_POINT_FILE_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+
+#include <boost/noncopyable.hpp>
+
+#include <interactive_marker_tutorials/aabb_kernel.h>
+
+namespace interactive_marker_tutorials
+{
+
+// Point files hold packed float32 coordinates that can be mapped into
+// memory instead of being read onto the heap.
+//
+// Layout: the 8 byte magic "IMTPTS1", the number of points as uint64,
+// then x, y and z of every point as float32.  Everything is in host
+// byte order, which is little endian on all platforms ROS supports.
+struct PointFileHeader
+{
+  char magic[8];
+  uint64_t num_points;
+};
+
+static const char POINT_FILE_MAGIC[8] = "IMTPTS1";
+
+// Writes a point file one point at a time, so that files larger than
+// memory can be produced.
+class PointFileWriter : boost::noncopyable
+{
+public:
+  PointFileWriter() : file_( 0 ), num_points_( 0 ) {}
+  ~PointFileWriter() { close(); }
+
+  bool open( const std::string& path )
+  {
+    close();
+    file_ = fopen( path.c_str(), "wb" );
+    num_points_ = 0;
+    return file_ && writeHeader();
+  }
+
+  void append( float x, float y, float z )
+  {
+    float p[3] = { x, y, z };
+    fwrite( p, sizeof( p ), 1, file_ );
+    num_points_++;
+  }
+
+  // Fill in the point count and close the file.  Returns false if any
+  // write failed.
+  bool close()
+  {
+    if ( !file_ )
+    {
+      return false;
+    }
+    bool ok = !ferror( file_ ) && fseek( file_, 0, SEEK_SET ) == 0 && writeHeader();
+    ok = fclose( file_ ) == 0 && ok;
+    file_ = 0;
+    return ok;
+  }
+
+private:
+  bool writeHeader()
+  {
+    PointFileHeader header;
+    memcpy( header.magic, POINT_FILE_MAGIC, sizeof( header.magic ) );
+    header.num_points = num_points_;
+    return fwrite( &header, sizeof( header ), 1, file_ ) == 1;
+  }
+
+  FILE* file_;
+  uint64_t num_points_;
+};
+
+// A read-only memory mapping of a point file.
+//
+// Pages are only loaded when touched, and classify() hands the pages
+// it has processed back to the kernel, so a pass over the whole file
+// keeps only the chunks currently being classified resident.  Usable
+// as the cloud argument of PointKdTree and the point source of the
+// selection tools.
+class MappedPointFile : boost::noncopyable
+{
+public:
+  MappedPointFile() : map_( 0 ), map_size_( 0 ), data_( 0 ), num_points_( 0 ) {}
+  ~MappedPointFile() { close(); }
+
+  // Returns false if the file can't be mapped or isn't a point file,
+  // with errno describing the problem.  Points are indexed with 32 bits
+  // everywhere downstream, so files of more than 2^32 - 1 points are
+  // refused with EFBIG.
+  bool open( const std::string& path )
+  {
+    close();
+
+    int fd = ::open( path.c_str(), O_RDONLY );
+    if ( fd < 0 )
+    {
+      return false;
+    }
+    struct stat st;
+    if ( fstat( fd, &st ) != 0 || (size_t)st.st_size < sizeof( PointFileHeader ) )
+    {
+      ::close( fd );
+      errno = EINVAL;
+      return false;
+    }
+
+    void* map = mmap( 0, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+    ::close( fd );
+    if ( map == MAP_FAILED )
+    {
+      return false;
+    }
+    map_ = map;
+    map_size_ = st.st_size;
+
+    const PointFileHeader* header = static_cast<const PointFileHeader*>( map_ );
+    if ( memcmp( header->magic, POINT_FILE_MAGIC, sizeof( header->magic ) ) != 0 ||
+         header->num_points > ( map_size_ - sizeof( PointFileHeader ) ) / ( 3 * sizeof( float ) ) )
+    {
+      close();
+      errno = EINVAL;
+      return false;
+    }
+    if ( header->num_points > UINT32_MAX )
+    {
+      close();
+      errno = EFBIG;
+      return false;
+    }
+    num_points_ = header->num_points;
+    data_ = reinterpret_cast<const float*>( header + 1 );
+    return true;
+  }
+
+  void close()
+  {
+    if ( map_ )
+    {
+      munmap( map_, map_size_ );
+    }
+    map_ = 0;
+    map_size_ = 0;
+    data_ = 0;
+    num_points_ = 0;
+  }
+
+  size_t size() const { return num_points_; }
+  float x( size_t i ) const { return data_[3 * i]; }
+  float y( size_t i ) const { return data_[3 * i + 1]; }
+  float z( size_t i ) const { return data_[3 * i + 2]; }
+
+  // Classify points [begin, end) into mask, which points at the word of
+  // point begin (a multiple of 64).  The points are split into x, y and
+  // z in small blocks on the stack for the box kernel.
+  void classify( size_t begin, size_t end, const Aabb& box, uint64_t* mask ) const
+  {
+    const size_t block_size = 1024;
+    float x[block_size], y[block_size], z[block_size];
+
+    for ( size_t block=begin; block<end; block+=block_size )
+    {
+      size_t count = std::min( block_size, end - block );
+      const float* p = data_ + 3 * block;
+      for ( size_t i=0; i<count; i++ )
+      {
+        x[i] = p[3 * i];
+        y[i] = p[3 * i + 1];
+        z[i] = p[3 * i + 2];
+      }
+      classifyAabb( x, y, z, count, box, mask + ( block - begin ) / 64 );
+    }
+
+    release( begin, end );
+  }
+
+  // Drop the pages holding only points of [begin, end) from memory.
+  // They are read from the file again if touched later.
+  void release( size_t begin, size_t end ) const
+  {
+    size_t page = sysconf( _SC_PAGESIZE );
+    uintptr_t first = reinterpret_cast<uintptr_t>( data_ + 3 * begin );
+    uintptr_t last = reinterpret_cast<uintptr_t>( data_ + 3 * end );
+    first = ( first + page - 1 ) / page * page;
+    last = last / page * page;
+    if ( first < last )
+    {
+      madvise( reinterpret_cast<void*>( first ), last - first, MADV_DONTNEED );
+    }
+  }
+
+private:
+  void* map_;
+  size_t map_size_;
+  const float* data_;
+  size_t num_points_;
+};
+
+} // end namespace interactive_marker_tutorials
+
+#endif // INTERACTIVE_MARKER_TUTORIALS_POINT_FILE_H
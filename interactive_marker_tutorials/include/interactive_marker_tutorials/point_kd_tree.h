@@ -0,0 +1,473 @@
+/*
+ * Copyright (c) 2011, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef INTERACTIVE_MARKER_TUTORIALS_POINT_KD_TREE_H
+#define INTERACTIVE_MARKER_TUTORIALS_POINT_KD_TREE_H
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace interactive_marker_tutorials
+{
+
+// An axis-aligned box in single precision, matching the point data
+// the selection tools work on.
+struct Aabb
+{
+  float min[3];
+  float max[3];
+
+  // An empty box, ready to be grown with extend().
+  Aabb()
+  {
+    for ( int axis=0; axis<3; axis++ )
+    {
+      min[axis] = std::numeric_limits<float>::max();
+      max[axis] = -std::numeric_limits<float>::max();
+    }
+  }
+
+  Aabb( float min_x, float min_y, float min_z, float max_x, float max_y, float max_z )
+  {
+    min[0] = min_x; min[1] = min_y; min[2] = min_z;
+    max[0] = max_x; max[1] = max_y; max[2] = max_z;
+  }
+
+  void extend( float x, float y, float z )
+  {
+    min[0] = std::min( min[0], x ); max[0] = std::max( max[0], x );
+    min[1] = std::min( min[1], y ); max[1] = std::max( max[1], y );
+    min[2] = std::min( min[2], z ); max[2] = std::max( max[2], z );
+  }
+
+  void extend( const Aabb& other )
+  {
+    for ( int axis=0; axis<3; axis++ )
+    {
+      min[axis] = std::min( min[axis], other.min[axis] );
+      max[axis] = std::max( max[axis], other.max[axis] );
+    }
+  }
+
+  bool contains( float x, float y, float z ) const
+  {
+    return min[0] <= x && x <= max[0] &&
+           min[1] <= y && y <= max[1] &&
+           min[2] <= z && z <= max[2];
+  }
+
+  bool contains( const Aabb& other ) const
+  {
+    return min[0] <= other.min[0] && other.max[0] <= max[0] &&
+           min[1] <= other.min[1] && other.max[1] <= max[1] &&
+           min[2] <= other.min[2] && other.max[2] <= max[2];
+  }
+
+  bool overlaps( const Aabb& other ) const
+  {
+    return min[0] <= other.max[0] && other.min[0] <= max[0] &&
+           min[1] <= other.max[1] && other.min[1] <= max[1] &&
+           min[2] <= other.max[2] && other.min[2] <= max[2];
+  }
+
+  bool operator==( const Aabb& other ) const
+  {
+    return std::equal( min, min + 3, other.min ) && std::equal( max, max + 3, other.max );
+  }
+
+  bool operator!=( const Aabb& other ) const { return !( *this == other ); }
+};
+
+// A k-d tree over the indices of a point cloud, answering box queries
+// without touching every point.
+//
+// The tree does not own the points.  Every method that needs
+// coordinates takes the cloud as a template argument, which only has
+// to provide size(), x(i), y(i) and z(i).  The tree must be rebuilt
+// whenever the cloud changes.
+//
+// Points with a NaN or infinite coordinate, like the invalid returns of
+// organized lidar clouds, are left out of the tree: they can't be
+// ordered along an axis, and they are inside no volume anyway.
+class PointKdTree
+{
+public:
+  explicit PointKdTree( unsigned leaf_size = 64 ) :
+    leaf_size_( std::max( leaf_size, 1u ) )
+  {
+  }
+
+  // The points are copied into a scratch array together with their
+  // indices and partitioned there, so that the partitioning moves
+  // contiguous memory instead of chasing indices into the cloud.  The
+  // nodes and the index order keep their memory, rebuilding for every
+  // scan of a sensor only allocates them when the scans grow.  The
+  // scratch array takes 16 bytes per point and is freed again once the
+  // tree is built; allocating it per build is cheap next to the build.
+  template<class Cloud>
+  void build( const Cloud& cloud )
+  {
+    uint32_t cloud_size = cloud.size();
+
+    build_points_.resize( cloud_size );
+    unindexed_.clear();
+    uint32_t num_points = 0;
+    for ( uint32_t i=0; i<cloud_size; i++ )
+    {
+      float x = cloud.x( i ), y = cloud.y( i ), z = cloud.z( i );
+      if ( !std::isfinite( x ) || !std::isfinite( y ) || !std::isfinite( z ) )
+      {
+        unindexed_.push_back( i );
+        continue;
+      }
+      BuildPoint& p = build_points_[num_points++];
+      p.coords[0] = x;
+      p.coords[1] = y;
+      p.coords[2] = z;
+      p.index = i;
+    }
+    build_points_.resize( num_points );
+
+    nodes_.clear();
+    nodes_.reserve( 4 * num_points / leaf_size_ + 1 );
+    nodes_.push_back( Node( 0, num_points ) );
+    buildNode( 0 );
+
+    order_.resize( num_points );
+    for ( uint32_t i=0; i<num_points; i++ )
+    {
+      order_[i] = build_points_[i].index;
+    }
+    std::vector<BuildPoint>().swap( build_points_ );
+  }
+
+  void clear()
+  {
+    nodes_.clear();
+    order_.clear();
+    unindexed_.clear();
+  }
+
+  // Number of points in the tree, without the non-finite ones.
+  size_t size() const { return order_.size(); }
+
+  // Bounds of all points in the tree.
+  Aabb bounds() const { return nodes_.empty() ? Aabb() : nodes_[0].bounds; }
+
+  // Append the indices of all points inside box to inside.
+  template<class Cloud>
+  void query( const Cloud& cloud, const Aabb& box, std::vector<uint32_t>& inside ) const
+  {
+    if ( !nodes_.empty() )
+    {
+      queryNode( cloud, box, 0, inside, 0 );
+    }
+  }
+
+  // Append the indices of all points inside box to inside and those of
+  // all other points, including the non-finite ones, to outside.
+  // Subtrees entirely on one side of the box are copied over without
+  // looking at their points.
+  template<class Cloud>
+  void partition( const Cloud& cloud, const Aabb& box,
+                  std::vector<uint32_t>& inside, std::vector<uint32_t>& outside ) const
+  {
+    if ( !nodes_.empty() )
+    {
+      queryNode( cloud, box, 0, inside, &outside );
+    }
+    outside.insert( outside.end(), unindexed_.begin(), unindexed_.end() );
+  }
+
+  // Find the point closest to (x, y, z).  Subtrees whose bounds are
+  // farther away than the closest point found so far are skipped, and
+  // the nearer child is searched first, so a lookup only touches a few
+  // leaves.  Returns false if the tree is empty.
+  template<class Cloud>
+  bool nearest( const Cloud& cloud, float x, float y, float z, uint32_t& index ) const
+  {
+    if ( order_.empty() )
+    {
+      return false;
+    }
+    float best = std::numeric_limits<float>::max();
+    nearestNode( cloud, x, y, z, 0, best, index );
+    return true;
+  }
+
+  // Set the bits of all points inside volume in mask, which must hold
+  // one bit per point of cloud, and clear all others.  Volume needs
+  // contains( Aabb ), overlaps( Aabb ) and a block kernel
+  // classify( x, y, z, n, mask ), like OrientedBox or PolygonPrism.
+  // Subtrees outside or inside the volume are decided from their bounds
+  // alone; the points of the leaves in between are gathered into small
+  // blocks for the kernel.
+  template<class Cloud, class Volume>
+  void classify( const Cloud& cloud, const Volume& volume, uint64_t* mask ) const
+  {
+    std::fill( mask, mask + ( cloud.size() + 63 ) / 64, 0 );
+    if ( !nodes_.empty() )
+    {
+      classifyNode( cloud, volume, 0, mask );
+    }
+  }
+
+private:
+  struct Node
+  {
+    Node( uint32_t b, uint32_t e ) : begin( b ), end( e ), child( 0 ) {}
+
+    Aabb bounds;
+    // range of order_ covered by this node
+    uint32_t begin, end;
+    // index of the first of two children, 0 for leaves
+    uint32_t child;
+  };
+
+  struct BuildPoint
+  {
+    float coords[3];
+    uint32_t index;
+  };
+
+  struct AxisLess
+  {
+    explicit AxisLess( int a ) : axis( a ) {}
+    bool operator()( const BuildPoint& a, const BuildPoint& b ) const
+    {
+      return a.coords[axis] < b.coords[axis];
+    }
+    int axis;
+  };
+
+  void extend( Aabb& bounds, uint32_t i ) const
+  {
+    const BuildPoint& p = build_points_[i];
+    bounds.extend( p.coords[0], p.coords[1], p.coords[2] );
+  }
+
+  void buildNode( uint32_t index )
+  {
+    uint32_t begin = nodes_[index].begin;
+    uint32_t end = nodes_[index].end;
+
+    if ( end - begin <= leaf_size_ )
+    {
+      Aabb bounds;
+      for ( uint32_t i=begin; i<end; i++ )
+      {
+        extend( bounds, i );
+      }
+      nodes_[index].bounds = bounds;
+      return;
+    }
+
+    // split along the widest axis of a sample of the range, which is
+    // close enough to the real extent and keeps the build O(n log n)
+    Aabb sample;
+    uint32_t stride = std::max( ( end - begin ) / 64, 1u );
+    for ( uint32_t i=begin; i<end; i+=stride )
+    {
+      extend( sample, i );
+    }
+    int axis = 0;
+    for ( int a=1; a<3; a++ )
+    {
+      if ( sample.max[a] - sample.min[a] > sample.max[axis] - sample.min[axis] ) axis = a;
+    }
+
+    uint32_t mid = begin + ( end - begin ) / 2;
+    std::nth_element( build_points_.begin() + begin, build_points_.begin() + mid,
+                      build_points_.begin() + end, AxisLess( axis ) );
+
+    uint32_t child = nodes_.size();
+    nodes_[index].child = child;
+    nodes_.push_back( Node( begin, mid ) );
+    nodes_.push_back( Node( mid, end ) );
+    buildNode( child );
+    buildNode( child + 1 );
+
+    Aabb bounds = nodes_[child].bounds;
+    bounds.extend( nodes_[child + 1].bounds );
+    nodes_[index].bounds = bounds;
+  }
+
+  template<class Cloud>
+  void queryNode( const Cloud& cloud, const Aabb& box, uint32_t index,
+                  std::vector<uint32_t>& inside, std::vector<uint32_t>* outside ) const
+  {
+    const Node& node = nodes_[index];
+
+    if ( !box.overlaps( node.bounds ) )
+    {
+      if ( outside )
+      {
+        outside->insert( outside->end(), order_.begin() + node.begin, order_.begin() + node.end );
+      }
+      return;
+    }
+
+    if ( box.contains( node.bounds ) )
+    {
+      inside.insert( inside.end(), order_.begin() + node.begin, order_.begin() + node.end );
+      return;
+    }
+
+    if ( node.child == 0 )
+    {
+      for ( uint32_t i=node.begin; i<node.end; i++ )
+      {
+        uint32_t p = order_[i];
+        if ( box.contains( cloud.x( p ), cloud.y( p ), cloud.z( p ) ) )
+        {
+          inside.push_back( p );
+        }
+        else if ( outside )
+        {
+          outside->push_back( p );
+        }
+      }
+      return;
+    }
+
+    queryNode( cloud, box, node.child, inside, outside );
+    queryNode( cloud, box, node.child + 1, inside, outside );
+  }
+
+  // squared distance from a point to the closest point of box
+  static float distanceSquared( const Aabb& box, float x, float y, float z )
+  {
+    float p[3] = { x, y, z };
+    float d = 0;
+    for ( int axis=0; axis<3; axis++ )
+    {
+      float out = std::max( std::max( box.min[axis] - p[axis], p[axis] - box.max[axis] ), 0.0f );
+      d += out * out;
+    }
+    return d;
+  }
+
+  template<class Cloud>
+  void nearestNode( const Cloud& cloud, float x, float y, float z, uint32_t index,
+                    float& best, uint32_t& best_index ) const
+  {
+    const Node& node = nodes_[index];
+
+    if ( node.child == 0 )
+    {
+      for ( uint32_t i=node.begin; i<node.end; i++ )
+      {
+        uint32_t p = order_[i];
+        float dx = cloud.x( p ) - x, dy = cloud.y( p ) - y, dz = cloud.z( p ) - z;
+        float d = dx * dx + dy * dy + dz * dz;
+        if ( d < best )
+        {
+          best = d;
+          best_index = p;
+        }
+      }
+      return;
+    }
+
+    float d[2] = { distanceSquared( nodes_[node.child].bounds, x, y, z ),
+                   distanceSquared( nodes_[node.child + 1].bounds, x, y, z ) };
+    int first = d[1] < d[0] ? 1 : 0;
+    for ( int i=0; i<2; i++ )
+    {
+      int child = i == 0 ? first : 1 - first;
+      if ( d[child] < best )
+      {
+        nearestNode( cloud, x, y, z, node.child + child, best, best_index );
+      }
+    }
+  }
+
+  template<class Cloud, class Volume>
+  void classifyNode( const Cloud& cloud, const Volume& volume, uint32_t index, uint64_t* mask ) const
+  {
+    const Node& node = nodes_[index];
+
+    if ( !volume.overlaps( node.bounds ) )
+    {
+      return;
+    }
+
+    if ( volume.contains( node.bounds ) )
+    {
+      for ( uint32_t i=node.begin; i<node.end; i++ )
+      {
+        mask[order_[i] / 64] |= (uint64_t)1 << ( order_[i] % 64 );
+      }
+      return;
+    }
+
+    if ( node.child == 0 )
+    {
+      float x[64], y[64], z[64];
+      uint64_t bits;
+      for ( uint32_t block=node.begin; block<node.end; block+=64 )
+      {
+        uint32_t n = std::min( node.end - block, 64u );
+        for ( uint32_t i=0; i<n; i++ )
+        {
+          uint32_t p = order_[block + i];
+          x[i] = cloud.x( p );
+          y[i] = cloud.y( p );
+          z[i] = cloud.z( p );
+        }
+        volume.classify( x, y, z, n, &bits );
+        for ( ; bits; bits &= bits - 1 )
+        {
+          uint32_t p = order_[block + __builtin_ctzll( bits )];
+          mask[p / 64] |= (uint64_t)1 << ( p % 64 );
+        }
+      }
+      return;
+    }
+
+    classifyNode( cloud, volume, node.child, mask );
+    classifyNode( cloud, volume, node.child + 1, mask );
+  }
+
+  unsigned leaf_size_;
+  std::vector<Node> nodes_;
+  std::vector<uint32_t> order_;
+  // the points left out for a non-finite coordinate
+  std::vector<uint32_t> unindexed_;
+  // the points being partitioned, only allocated during build()
+  std::vector<BuildPoint> build_points_;
+};
+
+} // end namespace interactive_marker_tutorials
+
+#endif // INTERACTIVE_MARKER_TUTORIALS_POINT_KD_TREE_H
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2011, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef INTERACTIVE_MARKER_TUTORIALS_POINT_STORE_H
+#define INTERACTIVE_MARKER_TUTORIALS_POINT_STORE_H
+
+#include <stdint.h>
+
+#include <vector>
+
+#include <interactive_marker_tutorials/aabb_kernel.h>
+
+namespace interactive_marker_tutorials
+{
+
+// Points stored as three separate float arrays (structure of arrays),
+// so that the box kernels can load several coordinates at once.  Also
+// usable as the cloud argument of PointKdTree.
+class PointStore
+{
+public:
+  PointStore() {}
+
+  explicit PointStore( size_t num_points ) { resize( num_points ); }
+
+  void resize( size_t num_points )
+  {
+    x_.resize( num_points );
+    y_.resize( num_points );
+    z_.resize( num_points );
+  }
+
+  void set( size_t i, float x, float y, float z )
+  {
+    x_[i] = x;
+    y_[i] = y;
+    z_[i] = z;
+  }
+
+  size_t size() const { return x_.size(); }
+  float x( size_t i ) const { return x_[i]; }
+  float y( size_t i ) const { return y_[i]; }
+  float z( size_t i ) const { return z_[i]; }
+
+  const float* xData() const { return x_.data(); }
+  const float* yData() const { return y_.data(); }
+  const float* zData() const { return z_.data(); }
+
+  // Resize mask to one bit per point and set the bits of all points
+  // inside box.  See aabb_kernel.h for the layout.
+  void classify( const Aabb& box, std::vector<uint64_t>& mask,
+                 AabbKernel kernel = bestAabbKernel() ) const
+  {
+    mask.resize( ( size() + 63 ) / 64 );
+    classifyAabb( xData(), yData(), zData(), size(), box, mask.data(), kernel );
+  }
+
+  // Classify points [begin, end) into mask, which points at the word of
+  // point begin (a multiple of 64).
+  void classify( size_t begin, size_t end, const Aabb& box, uint64_t* mask ) const
+  {
+    classifyAabb( xData() + begin, yData() + begin, zData() + begin, end - begin, box, mask );
+  }
+
+private:
+  std::vector<float> x_, y_, z_;
+};
+
+inline bool maskTest( const std::vector<uint64_t>& mask, size_t i )
+{
+  return ( mask[i / 64] >> ( i % 64 ) ) & 1;
+}
+
+inline void maskSet( std::vector<uint64_t>& mask, size_t i, bool value )
+{
+  uint64_t bit = (uint64_t)1 << ( i % 64 );
+  if ( value )
+  {
+    mask[i / 64] |= bit;
+  }
+  else
+  {
+    mask[i / 64] &= ~bit;
+  }
+}
+
+} // end namespace interactive_marker_tutorials
+
+#endif // INTERACTIVE_MARKER_TUTORIALS_POINT_STORE_H
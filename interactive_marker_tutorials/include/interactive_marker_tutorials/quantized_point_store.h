@@ -0,0 +1,210 @@
+/*
+ * Copyright (c) 2011, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef INTERACTIVE_MARKER_TUTORIALS_QUANTIZED_POINT_STORE_H
+#define INTERACTIVE_MARKER_TUTORIALS_QUANTIZED_POINT_STORE_H
+
+#include <math.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <interactive_marker_tutorials/aabb_kernel.h>
+
+namespace interactive_marker_tutorials
+{
+
+// Points quantized to 16 bits per coordinate over their bounding box,
+// 6 bytes per point.
+//
+// For comparison, at 10M points:
+//   std::vector<tf::Vector3>   32 bytes/point   320 MB
+//   PointStore                 12 bytes/point   120 MB
+//   QuantizedPointStore         6 bytes/point    60 MB
+// The rounding error is at most 1/131070 of the extent along each axis,
+// 0.8 mm for a 100 m scan.  Boxes are quantized instead of points, so
+// classification compares integers directly.
+class QuantizedPointStore
+{
+public:
+  QuantizedPointStore() {}
+
+  // Quantize any cloud with size(), x(i), y(i) and z(i).
+  template<class Cloud>
+  explicit QuantizedPointStore( const Cloud& cloud ) { assign( cloud ); }
+
+  template<class Cloud>
+  void assign( const Cloud& cloud )
+  {
+    size_t num_points = cloud.size();
+    Aabb bounds;
+    for ( size_t i=0; i<num_points; i++ )
+    {
+      bounds.extend( cloud.x( i ), cloud.y( i ), cloud.z( i ) );
+    }
+    for ( int axis=0; axis<3; axis++ )
+    {
+      origin_[axis] = num_points ? bounds.min[axis] : 0.0f;
+      float extent = num_points ? bounds.max[axis] - bounds.min[axis] : 0.0f;
+      step_[axis] = extent > 0.0f ? extent / 65535.0f : 1.0f;
+      q_[axis].resize( num_points );
+    }
+
+    for ( size_t i=0; i<num_points; i++ )
+    {
+      q_[0][i] = quantize( cloud.x( i ), 0 );
+      q_[1][i] = quantize( cloud.y( i ), 1 );
+      q_[2][i] = quantize( cloud.z( i ), 2 );
+    }
+  }
+
+  size_t size() const { return q_[0].size(); }
+  float x( size_t i ) const { return dequantize( q_[0][i], 0 ); }
+  float y( size_t i ) const { return dequantize( q_[1][i], 1 ); }
+  float z( size_t i ) const { return dequantize( q_[2][i], 2 ); }
+
+  // Classify points [begin, end) into mask, which points at the word of
+  // point begin (a multiple of 64).
+  void classify( size_t begin, size_t end, const Aabb& box, uint64_t* mask ) const
+  {
+    int16_t qmin[3], qmax[3];
+    if ( !quantizeBox( box, qmin, qmax ) )
+    {
+      std::fill( mask, mask + ( end - begin + 63 ) / 64, 0 );
+      return;
+    }
+
+    const int16_t* x = q_[0].data() + begin;
+    const int16_t* y = q_[1].data() + begin;
+    const int16_t* z = q_[2].data() + begin;
+    size_t n = end - begin;
+    size_t done = 0;
+
+#ifdef INTERACTIVE_MARKER_TUTORIALS_X86_KERNELS
+    if ( bestAabbKernel() != AABB_KERNEL_SCALAR )
+    {
+      done = n / 64 * 64;
+      classifySse( x, y, z, done, qmin, qmax, mask );
+    }
+#endif
+
+    for ( size_t word_begin=done; word_begin<n; word_begin+=64 )
+    {
+      size_t word_end = std::min( word_begin + 64, n );
+      uint64_t bits = 0;
+      for ( size_t i=word_begin; i<word_end; i++ )
+      {
+        uint64_t inside = ( qmin[0] <= x[i] ) & ( x[i] <= qmax[0] ) &
+                          ( qmin[1] <= y[i] ) & ( y[i] <= qmax[1] ) &
+                          ( qmin[2] <= z[i] ) & ( z[i] <= qmax[2] );
+        bits |= inside << ( i - word_begin );
+      }
+      mask[word_begin / 64] = bits;
+    }
+  }
+
+private:
+  // Stored values are offset by 32768 to fit signed compares.
+  int16_t quantize( float v, int axis ) const
+  {
+    float q = floorf( ( v - origin_[axis] ) / step_[axis] + 0.5f );
+    return (int16_t)( std::min( std::max( q, 0.0f ), 65535.0f ) - 32768.0f );
+  }
+
+  float dequantize( int q, int axis ) const
+  {
+    return origin_[axis] + ( q + 32768 ) * step_[axis];
+  }
+
+  // The range of stored values whose points lie inside box, false if
+  // there is none.  The estimate is nudged until it agrees exactly with
+  // comparing the dequantized coordinates.
+  bool quantizeBox( const Aabb& box, int16_t* qmin, int16_t* qmax ) const
+  {
+    for ( int axis=0; axis<3; axis++ )
+    {
+      float lo_estimate = ceilf( ( box.min[axis] - origin_[axis] ) / step_[axis] );
+      float hi_estimate = floorf( ( box.max[axis] - origin_[axis] ) / step_[axis] );
+      int lo = (int)std::min( std::max( lo_estimate, 0.0f ), 65536.0f ) - 32768;
+      int hi = (int)std::min( std::max( hi_estimate, -1.0f ), 65535.0f ) - 32768;
+
+      while ( lo > -32768 && dequantize( lo - 1, axis ) >= box.min[axis] ) lo--;
+      while ( lo <= 32767 && dequantize( lo, axis ) < box.min[axis] ) lo++;
+      while ( hi < 32767 && dequantize( hi + 1, axis ) <= box.max[axis] ) hi++;
+      while ( hi >= -32768 && dequantize( hi, axis ) > box.max[axis] ) hi--;
+
+      if ( lo > hi )
+      {
+        return false;
+      }
+      qmin[axis] = lo;
+      qmax[axis] = hi;
+    }
+    return true;
+  }
+
+#ifdef INTERACTIVE_MARKER_TUTORIALS_X86_KERNELS
+  __attribute__(( target( "sse2" ) ))
+  static void classifySse( const int16_t* x, const int16_t* y, const int16_t* z, size_t n,
+                           const int16_t* qmin, const int16_t* qmax, uint64_t* mask )
+  {
+    const __m128i min_x = _mm_set1_epi16( qmin[0] ), max_x = _mm_set1_epi16( qmax[0] );
+    const __m128i min_y = _mm_set1_epi16( qmin[1] ), max_y = _mm_set1_epi16( qmax[1] );
+    const __m128i min_z = _mm_set1_epi16( qmin[2] ), max_z = _mm_set1_epi16( qmax[2] );
+
+    for ( size_t w=0; w<n/64; w++ )
+    {
+      uint64_t outside = 0;
+      for ( size_t lane=0; lane<64; lane+=8 )
+      {
+        size_t i = w * 64 + lane;
+        __m128i px = _mm_loadu_si128( reinterpret_cast<const __m128i*>( x + i ) );
+        __m128i py = _mm_loadu_si128( reinterpret_cast<const __m128i*>( y + i ) );
+        __m128i pz = _mm_loadu_si128( reinterpret_cast<const __m128i*>( z + i ) );
+        __m128i out = _mm_or_si128( _mm_cmplt_epi16( px, min_x ), _mm_cmpgt_epi16( px, max_x ) );
+        out = _mm_or_si128( out, _mm_or_si128( _mm_cmplt_epi16( py, min_y ), _mm_cmpgt_epi16( py, max_y ) ) );
+        out = _mm_or_si128( out, _mm_or_si128( _mm_cmplt_epi16( pz, min_z ), _mm_cmpgt_epi16( pz, max_z ) ) );
+        // one byte per lane, then one bit per byte
+        uint64_t bits = _mm_movemask_epi8( _mm_packs_epi16( out, _mm_setzero_si128() ) ) & 0xff;
+        outside |= bits << lane;
+      }
+      mask[w] = ~outside;
+    }
+  }
+#endif
+
+  float origin_[3];
+  float step_[3];
+  std::vector<int16_t> q_[3];
+};
+
+} // end namespace interactive_marker_tutorials
+
+#endif // INTERACTIVE_MARKER_TUTORIALS_QUANTIZED_POINT_STORE_H
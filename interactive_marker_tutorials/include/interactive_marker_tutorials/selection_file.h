@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2011, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef INTERACTIVE_MARKER_TUTORIALS_SELECTION_FILE_H
+#define INTERACTIVE_MARKER_TUTORIALS_SELECTION_FILE_H
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+namespace interactive_marker_tutorials
+{
+
+// Selection files hold the indices of the selected points of a cloud.
+//
+// Layout: the 8 byte magic "IMTSEL1", the number of points in the
+// cloud and the number of selected points as uint64, then the indices
+// as uint32 in ascending order.  Like point files, everything is in
+// host byte order.
+struct SelectionFileHeader
+{
+  char magic[8];
+  uint64_t num_points;
+  uint64_t num_selected;
+};
+
+static const char SELECTION_FILE_MAGIC[8] = "IMTSEL1";
+
+// Returns false if the file can't be written, with errno describing
+// the problem.
+inline bool writeSelectionFile( const std::string& path, size_t num_points,
+                                const std::vector<uint32_t>& indices )
+{
+  FILE* file = fopen( path.c_str(), "wb" );
+  if ( !file )
+  {
+    return false;
+  }
+
+  SelectionFileHeader header;
+  memcpy( header.magic, SELECTION_FILE_MAGIC, sizeof( header.magic ) );
+  header.num_points = num_points;
+  header.num_selected = indices.size();
+
+  bool written = fwrite( &header, sizeof( header ), 1, file ) == 1 &&
+                 fwrite( indices.data(), sizeof( uint32_t ), indices.size(), file ) == indices.size();
+  int error = errno;
+  if ( fclose( file ) != 0 )
+  {
+    return false;
+  }
+  if ( !written )
+  {
+    errno = error;
+  }
+  return written;
+}
+
+} // end namespace interactive_marker_tutorials
+
+#endif // INTERACTIVE_MARKER_TUTORIALS_SELECTION_FILE_H
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2011, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef INTERACTIVE_MARKER_TUTORIALS_SELECTION_MASK_H
+#define INTERACTIVE_MARKER_TUTORIALS_SELECTION_MASK_H
+
+#include <stdint.h>
+
+#include <vector>
+
+namespace interactive_marker_tutorials
+{
+
+// Conversions between the in-memory selection mask (64 bit words, see
+// aabb_kernel.h) and its wire form in SelectionDelta messages.
+
+// Bytes of a mask over num_points points, least significant bit first.
+inline void packMask( const std::vector<uint64_t>& mask, size_t num_points, std::vector<uint8_t>& bytes )
+{
+  bytes.resize( ( num_points + 7 ) / 8 );
+  for ( size_t i=0; i<bytes.size(); i++ )
+  {
+    bytes[i] = ( mask[i / 8] >> ( 8 * ( i % 8 ) ) ) & 0xff;
+  }
+}
+
+inline void unpackMask( const std::vector<uint8_t>& bytes, size_t num_points, std::vector<uint64_t>& mask )
+{
+  mask.assign( ( num_points + 63 ) / 64, 0 );
+  for ( size_t i=0; i<bytes.size() && i<mask.size() * 8; i++ )
+  {
+    mask[i / 8] |= (uint64_t)bytes[i] << ( 8 * ( i % 8 ) );
+  }
+}
+
+// Indices of the points whose bit is set, in ascending order.  The
+// output is sized by a popcount first, so it is allocated only once.
+inline void maskIndices( const std::vector<uint64_t>& mask, std::vector<uint32_t>& indices )
+{
+  size_t count = 0;
+  for ( size_t w=0; w<mask.size(); w++ )
+  {
+    count += __builtin_popcountll( mask[w] );
+  }
+
+  indices.resize( count );
+  uint32_t* out = indices.data();
+  for ( size_t w=0; w<mask.size(); w++ )
+  {
+    for ( uint64_t bits=mask[w]; bits; bits &= bits - 1 )
+    {
+      *out++ = w * 64 + __builtin_ctzll( bits );
+    }
+  }
+}
+
+// Indices of the points whose bit differs between two masks of the
+// same size.  Visits every word once, but only writes per changed point.
+inline void maskDelta( const std::vector<uint64_t>& before, const std::vector<uint64_t>& after,
+                       std::vector<uint32_t>& toggled )
+{
+  toggled.clear();
+  for ( size_t w=0; w<after.size(); w++ )
+  {
+    uint64_t bits = before[w] ^ after[w];
+    while ( bits )
+    {
+      toggled.push_back( w * 64 + __builtin_ctzll( bits ) );
+      bits &= bits - 1;
+    }
+  }
+}
+
+inline void applyDelta( std::vector<uint64_t>& mask, const std::vector<uint32_t>& toggled )
+{
+  for ( size_t i=0; i<toggled.size(); i++ )
+  {
+    if ( toggled[i] / 64 < mask.size() )
+    {
+      mask[toggled[i] / 64] ^= (uint64_t)1 << ( toggled[i] % 64 );
+    }
+  }
+}
+
+} // end namespace interactive_marker_tutorials
+
+#endif // INTERACTIVE_MARKER_TUTORIALS_SELECTION_MASK_H
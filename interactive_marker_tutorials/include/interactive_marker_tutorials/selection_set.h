@@ -0,0 +1,366 @@
+/*
+ * Copyright (c) 2011, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef INTERACTIVE_MARKER_TUTORIALS_SELECTION_SET_H
+#define INTERACTIVE_MARKER_TUTORIALS_SELECTION_SET_H
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <interactive_marker_tutorials/aabb_kernel.h>
+#include <interactive_marker_tutorials/parallel_classify.h>
+#include <interactive_marker_tutorials/point_kd_tree.h>
+#include <interactive_marker_tutorials/point_store.h>
+#include <interactive_marker_tutorials/selection_volume.h>
+#include <interactive_marker_tutorials/worker_pool.h>
+
+namespace interactive_marker_tutorials
+{
+
+// Bounds of the region in which points may be inside one box but not
+// the other.  When a single face moves, this is the slab between its
+// old and new position.
+inline Aabb sweptRegion( const Aabb& a, const Aabb& b )
+{
+  Aabb region = a;
+  int changed_axes = 0;
+  for ( int axis=0; axis<3; axis++ )
+  {
+    bool min_changed = a.min[axis] != b.min[axis];
+    bool max_changed = a.max[axis] != b.max[axis];
+    if ( !min_changed && !max_changed ) continue;
+    changed_axes++;
+
+    if ( min_changed && !max_changed )
+    {
+      region.min[axis] = std::min( a.min[axis], b.min[axis] );
+      region.max[axis] = std::max( a.min[axis], b.min[axis] );
+    }
+    else if ( max_changed && !min_changed )
+    {
+      region.min[axis] = std::min( a.max[axis], b.max[axis] );
+      region.max[axis] = std::max( a.max[axis], b.max[axis] );
+    }
+    else
+    {
+      region.min[axis] = std::min( a.min[axis], b.min[axis] );
+      region.max[axis] = std::max( a.max[axis], b.max[axis] );
+    }
+  }
+
+  if ( changed_axes == 0 )
+  {
+    return Aabb();
+  }
+  if ( changed_axes > 1 )
+  {
+    region = a;
+    region.extend( b );
+  }
+  return region;
+}
+
+// A selection made of several named boxes combined with set operations.
+// Besides axis-aligned boxes, oriented boxes and polygon prisms can be
+// used.
+//
+// Boxes are applied in the order they were added, each one combining
+// with the result of those before it, so "a", "b" with DIFFERENCE and
+// "c" with UNION selects (a - b) + c.  The operation of the first box is
+// ignored.  Every box keeps its own mask, so changing one box only
+// reclassifies the points against that box; the masks are then combined
+// word by word.
+class SelectionSet
+{
+public:
+  enum Operation
+  {
+    UNION,
+    INTERSECTION,
+    DIFFERENCE
+  };
+
+  SelectionSet() : combined_dirty_( true ) {}
+
+  // Add a box, or change the box and operation of an existing one.
+  void setBox( const std::string& name, const Aabb& box, Operation operation = UNION )
+  {
+    Entry* entry = set( name, Entry::AABB, operation );
+    entry->box = box;
+  }
+
+  void setOrientedBox( const std::string& name, const OrientedBox& box, Operation operation = UNION )
+  {
+    Entry* entry = set( name, Entry::ORIENTED_BOX, operation );
+    entry->oriented_box = box;
+  }
+
+  void setPolygonPrism( const std::string& name, const PolygonPrism& prism, Operation operation = UNION )
+  {
+    Entry* entry = set( name, Entry::POLYGON_PRISM, operation );
+    entry->prism = prism;
+  }
+
+  bool removeBox( const std::string& name )
+  {
+    for ( size_t i=0; i<entries_.size(); i++ )
+    {
+      if ( entries_[i].name == name )
+      {
+        entries_.erase( entries_.begin() + i );
+        combined_dirty_ = true;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Classify all boxes again on the next update, for when the points
+  // changed.
+  void invalidate()
+  {
+    for ( size_t i=0; i<entries_.size(); i++ )
+    {
+      entries_[i].dirty = true;
+    }
+    combined_dirty_ = true;
+  }
+
+  bool hasBox( const std::string& name ) const
+  {
+    return const_cast<SelectionSet*>( this )->find( name ) != 0;
+  }
+
+  // Move a box whose mask is up to date, re-testing only the points in
+  // the region swept by its faces.  tree must index points.
+  template<class Points>
+  void moveBox( const std::string& name, const Aabb& box, const Points& points, const PointKdTree& tree )
+  {
+    Entry* entry = find( name );
+    if ( !entry || entry->dirty || entry->shape != Entry::AABB )
+    {
+      setBox( name, box, entry ? entry->operation : UNION );
+      return;
+    }
+
+    candidates_.clear();
+    tree.query( points, sweptRegion( entry->box, box ), candidates_ );
+    for ( size_t i=0; i<candidates_.size(); i++ )
+    {
+      uint32_t p = candidates_[i];
+      maskSet( entry->mask, p, box.contains( points.x( p ), points.y( p ), points.z( p ) ) );
+    }
+    entry->box = box;
+    combined_dirty_ = true;
+  }
+
+  // Bring the combined selection in mask up to date.  Boxes that changed
+  // are classified chunk by chunk, and each chunk is combined right away
+  // while its words are still in cache, so this is a single pass over
+  // the points however many boxes changed.
+  //
+  // All volumes are classified through tree if given, which must index
+  // points; that skips everything outside their bounds and takes whole
+  // subtrees inside them, but runs on one thread.  Without a tree they
+  // are classified in the chunk pass, boxes with the box kernels of the
+  // points and the others gathering the points into blocks for theirs.
+  template<class Points>
+  void update( WorkerPool& pool, const Points& points, std::vector<uint64_t>& mask,
+               const PointKdTree* tree = 0 )
+  {
+    size_t num_points = points.size();
+    size_t num_words = ( num_points + 63 ) / 64;
+    if ( !combined_dirty_ && mask.size() == num_words )
+    {
+      return;
+    }
+
+    std::vector<Entry*> dirty;
+    for ( size_t i=0; i<entries_.size(); i++ )
+    {
+      Entry& entry = entries_[i];
+      if ( entry.dirty || entry.mask.size() != num_words )
+      {
+        entry.mask.resize( num_words );
+        if ( tree && entry.shape == Entry::AABB )
+        {
+          tree->classify( points, AabbVolume( entry.box ), entry.mask.data() );
+        }
+        else if ( tree && entry.shape == Entry::ORIENTED_BOX )
+        {
+          tree->classify( points, entry.oriented_box, entry.mask.data() );
+        }
+        else if ( tree && entry.shape == Entry::POLYGON_PRISM )
+        {
+          tree->classify( points, entry.prism, entry.mask.data() );
+        }
+        else
+        {
+          dirty.push_back( &entry );
+        }
+      }
+    }
+    mask.resize( num_words );
+
+    size_t chunk_words = maskWordsPerChunk( pool, num_words );
+    size_t num_chunks = ( num_words + chunk_words - 1 ) / chunk_words;
+    pool.parallelFor( num_chunks, [&]( size_t chunk )
+    {
+      size_t word_begin = chunk * chunk_words;
+      size_t word_end = std::min( word_begin + chunk_words, num_words );
+      size_t begin = word_begin * 64;
+      size_t end = std::min( word_end * 64, num_points );
+
+      for ( size_t i=0; i<dirty.size(); i++ )
+      {
+        uint64_t* entry_mask = dirty[i]->mask.data() + word_begin;
+        switch ( dirty[i]->shape )
+        {
+        case Entry::AABB:
+          points.classify( begin, end, dirty[i]->box, entry_mask );
+          break;
+        case Entry::ORIENTED_BOX:
+          classifyBlocks( points, begin, end, dirty[i]->oriented_box, entry_mask );
+          break;
+        case Entry::POLYGON_PRISM:
+          classifyBlocks( points, begin, end, dirty[i]->prism, entry_mask );
+          break;
+        }
+      }
+      combine( word_begin, word_end, mask );
+    } );
+
+    for ( size_t i=0; i<entries_.size(); i++ )
+    {
+      entries_[i].dirty = false;
+    }
+    combined_dirty_ = false;
+  }
+
+private:
+  struct Entry
+  {
+    enum Shape
+    {
+      AABB,
+      ORIENTED_BOX,
+      POLYGON_PRISM
+    };
+
+    std::string name;
+    Shape shape;
+    // only the one matching shape is used
+    Aabb box;
+    OrientedBox oriented_box;
+    PolygonPrism prism;
+    Operation operation;
+    std::vector<uint64_t> mask;
+    // mask doesn't match box
+    bool dirty;
+  };
+
+  Entry* set( const std::string& name, Entry::Shape shape, Operation operation )
+  {
+    Entry* entry = find( name );
+    if ( !entry )
+    {
+      entries_.push_back( Entry() );
+      entry = &entries_.back();
+      entry->name = name;
+    }
+    entry->shape = shape;
+    entry->operation = operation;
+    entry->dirty = true;
+    combined_dirty_ = true;
+    return entry;
+  }
+
+  // Classify points [begin, end) of any point source with a volume
+  // kernel, 64 points at a time.  begin is on a word boundary.
+  template<class Points, class Volume>
+  static void classifyBlocks( const Points& points, size_t begin, size_t end,
+                              const Volume& volume, uint64_t* mask )
+  {
+    float x[64], y[64], z[64];
+    for ( size_t block=begin; block<end; block+=64 )
+    {
+      size_t n = std::min( end - block, (size_t)64 );
+      for ( size_t i=0; i<n; i++ )
+      {
+        x[i] = points.x( block + i );
+        y[i] = points.y( block + i );
+        z[i] = points.z( block + i );
+      }
+      volume.classify( x, y, z, n, mask + ( block - begin ) / 64 );
+    }
+  }
+
+  Entry* find( const std::string& name )
+  {
+    for ( size_t i=0; i<entries_.size(); i++ )
+    {
+      if ( entries_[i].name == name )
+      {
+        return &entries_[i];
+      }
+    }
+    return 0;
+  }
+
+  void combine( size_t word_begin, size_t word_end, std::vector<uint64_t>& mask ) const
+  {
+    for ( size_t w=word_begin; w<word_end; w++ )
+    {
+      uint64_t bits = entries_.empty() ? 0 : entries_[0].mask[w];
+      for ( size_t i=1; i<entries_.size(); i++ )
+      {
+        switch ( entries_[i].operation )
+        {
+        case UNION: bits |= entries_[i].mask[w]; break;
+        case INTERSECTION: bits &= entries_[i].mask[w]; break;
+        case DIFFERENCE: bits &= ~entries_[i].mask[w]; break;
+        }
+      }
+      mask[w] = bits;
+    }
+  }
+
+  // std::vector keeps the order of operations; selections have a handful
+  // of boxes, so lookups by name are linear
+  std::vector<Entry> entries_;
+  std::vector<uint32_t> candidates_;
+  bool combined_dirty_;
+};
+
+} // end namespace interactive_marker_tutorials
+
+#endif // INTERACTIVE_MARKER_TUTORIALS_SELECTION_SET_H
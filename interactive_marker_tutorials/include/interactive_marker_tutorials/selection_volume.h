@@ -0,0 +1,415 @@
+/*
+ * Copyright (c) 2011, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef INTERACTIVE_MARKER_TUTORIALS_SELECTION_VOLUME_H
+#define INTERACTIVE_MARKER_TUTORIALS_SELECTION_VOLUME_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <interactive_marker_tutorials/aabb_kernel.h>
+#include <interactive_marker_tutorials/point_kd_tree.h>
+
+namespace interactive_marker_tutorials
+{
+
+// Selection volumes other than axis-aligned boxes.
+//
+// Every volume can tell whether an Aabb is entirely inside it or may
+// overlap it, which lets PointKdTree::classify() skip or take whole
+// subtrees, and classifies blocks of points stored as separate x, y and
+// z arrays with the same mask layout as classifyAabb().  The kernels
+// have a scalar and an AVX2 variant which agree bit for bit; CPUs
+// without AVX2 use the scalar one.
+
+// A box rotated into an arbitrary orientation.
+struct OrientedBox
+{
+  float center[3];
+  // unit vectors along the box edges, in base_link
+  float axes[3][3];
+  // half the edge lengths
+  float half[3];
+
+  // An empty box at the origin.
+  OrientedBox()
+  {
+    *this = OrientedBox( 0, 0, 0, 0, 0, 0 );
+  }
+
+  // A box of the given size around center, rotated by the quaternion
+  // (qx, qy, qz, qw).
+  OrientedBox( float cx, float cy, float cz, float size_x, float size_y, float size_z,
+               float qx = 0, float qy = 0, float qz = 0, float qw = 1 )
+  {
+    center[0] = cx; center[1] = cy; center[2] = cz;
+    half[0] = 0.5f * fabsf( size_x ); half[1] = 0.5f * fabsf( size_y ); half[2] = 0.5f * fabsf( size_z );
+
+    float norm = sqrtf( qx*qx + qy*qy + qz*qz + qw*qw );
+    if ( norm > 0 )
+    {
+      qx /= norm; qy /= norm; qz /= norm; qw /= norm;
+    }
+    else
+    {
+      qw = 1;
+    }
+
+    // columns of the rotation matrix
+    axes[0][0] = 1 - 2*(qy*qy + qz*qz); axes[0][1] = 2*(qx*qy + qz*qw);     axes[0][2] = 2*(qx*qz - qy*qw);
+    axes[1][0] = 2*(qx*qy - qz*qw);     axes[1][1] = 1 - 2*(qx*qx + qz*qz); axes[1][2] = 2*(qy*qz + qx*qw);
+    axes[2][0] = 2*(qx*qz + qy*qw);     axes[2][1] = 2*(qy*qz - qx*qw);     axes[2][2] = 1 - 2*(qx*qx + qy*qy);
+  }
+
+  Aabb bounds() const
+  {
+    Aabb box;
+    for ( int i=0; i<3; i++ )
+    {
+      float extent = fabsf( axes[0][i] ) * half[0] + fabsf( axes[1][i] ) * half[1] + fabsf( axes[2][i] ) * half[2];
+      box.min[i] = center[i] - extent;
+      box.max[i] = center[i] + extent;
+    }
+    return box;
+  }
+
+  // Coordinate of a point along one of the box axes, relative to the
+  // center.  The kernels compute it in the same order.
+  float local( int axis, float x, float y, float z ) const
+  {
+    return ( x - center[0] ) * axes[axis][0] + ( y - center[1] ) * axes[axis][1] + ( z - center[2] ) * axes[axis][2];
+  }
+
+  bool contains( float x, float y, float z ) const
+  {
+    return fabsf( local( 0, x, y, z ) ) <= half[0] &&
+           fabsf( local( 1, x, y, z ) ) <= half[1] &&
+           fabsf( local( 2, x, y, z ) ) <= half[2];
+  }
+
+  // The box is convex, so it contains other if it contains all corners.
+  bool contains( const Aabb& other ) const
+  {
+    for ( int corner=0; corner<8; corner++ )
+    {
+      if ( !contains( corner & 1 ? other.max[0] : other.min[0],
+                      corner & 2 ? other.max[1] : other.min[1],
+                      corner & 4 ? other.max[2] : other.min[2] ) )
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // False only if other is certainly outside, tested along the axes of
+  // both boxes.
+  bool overlaps( const Aabb& other ) const
+  {
+    if ( !bounds().overlaps( other ) )
+    {
+      return false;
+    }
+    float c[3], e[3];
+    for ( int i=0; i<3; i++ )
+    {
+      c[i] = 0.5f * ( other.min[i] + other.max[i] );
+      e[i] = 0.5f * ( other.max[i] - other.min[i] );
+    }
+    for ( int axis=0; axis<3; axis++ )
+    {
+      float radius = fabsf( axes[axis][0] ) * e[0] + fabsf( axes[axis][1] ) * e[1] + fabsf( axes[axis][2] ) * e[2];
+      if ( fabsf( local( axis, c[0], c[1], c[2] ) ) > half[axis] + radius )
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void classify( const float* x, const float* y, const float* z, size_t n, uint64_t* mask ) const;
+};
+
+// A polygon in the x-y plane of base_link, extruded from min_z to max_z.
+// The polygon may be concave; points are inside by the even-odd rule.
+struct PolygonPrism
+{
+  PolygonPrism() : min_z( 0 ), max_z( 0 ) {}
+
+  void addVertex( float x, float y )
+  {
+    xs.push_back( x );
+    ys.push_back( y );
+  }
+
+  std::vector<float> xs, ys;
+  float min_z, max_z;
+
+  Aabb bounds() const
+  {
+    Aabb box;
+    for ( size_t i=0; i<xs.size(); i++ )
+    {
+      box.extend( xs[i], ys[i], min_z );
+      box.extend( xs[i], ys[i], max_z );
+    }
+    return box;
+  }
+
+  // Crossing test, done exactly like the kernels: an edge is crossed if
+  // it straddles y and the point lies left of it.
+  bool containsXY( float x, float y ) const
+  {
+    bool inside = false;
+    for ( size_t i=0, j=xs.size()-1; i<xs.size(); j=i++ )
+    {
+      if ( ( ys[i] > y ) != ( ys[j] > y ) && x < xs[i] + ( y - ys[i] ) * slope( i, j ) )
+      {
+        inside = !inside;
+      }
+    }
+    return inside;
+  }
+
+  bool contains( float x, float y, float z ) const
+  {
+    return min_z <= z && z <= max_z && !xs.empty() && containsXY( x, y );
+  }
+
+  // other is inside if one of its corners is and no edge of the polygon
+  // touches it.
+  bool contains( const Aabb& other ) const
+  {
+    if ( xs.empty() || other.min[2] < min_z || other.max[2] > max_z ||
+         !containsXY( other.min[0], other.min[1] ) )
+    {
+      return false;
+    }
+    for ( size_t i=0, j=xs.size()-1; i<xs.size(); j=i++ )
+    {
+      if ( segmentTouches( xs[j], ys[j], xs[i], ys[i], other ) )
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool overlaps( const Aabb& other ) const
+  {
+    return !xs.empty() && bounds().overlaps( other );
+  }
+
+  // dx/dy of the edge from vertex j to vertex i, 0 for horizontal edges
+  // (which are never crossed)
+  float slope( size_t i, size_t j ) const
+  {
+    return ys[j] != ys[i] ? ( xs[j] - xs[i] ) / ( ys[j] - ys[i] ) : 0.0f;
+  }
+
+  void classify( const float* x, const float* y, const float* z, size_t n, uint64_t* mask ) const;
+
+private:
+  // Whether the segment from a to b touches the x-y rectangle of box,
+  // by clipping it against the four sides.
+  static bool segmentTouches( float ax, float ay, float bx, float by, const Aabb& box )
+  {
+    float t0 = 0, t1 = 1;
+    float d[2] = { bx - ax, by - ay };
+    float a[2] = { ax, ay };
+    for ( int axis=0; axis<2; axis++ )
+    {
+      if ( d[axis] == 0 )
+      {
+        if ( a[axis] < box.min[axis] || a[axis] > box.max[axis] ) return false;
+        continue;
+      }
+      float ta = ( box.min[axis] - a[axis] ) / d[axis];
+      float tb = ( box.max[axis] - a[axis] ) / d[axis];
+      t0 = std::max( t0, std::min( ta, tb ) );
+      t1 = std::min( t1, std::max( ta, tb ) );
+      if ( t0 > t1 ) return false;
+    }
+    return true;
+  }
+};
+
+// Classify points [begin, n) one at a time, starting on a word boundary.
+inline void classifyOrientedBoxScalar( const float* x, const float* y, const float* z,
+                                       size_t begin, size_t n, const OrientedBox& box, uint64_t* mask )
+{
+  for ( size_t word_begin=begin; word_begin<n; word_begin+=64 )
+  {
+    size_t word_end = word_begin + 64 < n ? word_begin + 64 : n;
+    uint64_t bits = 0;
+    for ( size_t i=word_begin; i<word_end; i++ )
+    {
+      bits |= (uint64_t)box.contains( x[i], y[i], z[i] ) << ( i - word_begin );
+    }
+    mask[word_begin / 64] = bits;
+  }
+}
+
+inline void classifyPolygonPrismScalar( const float* x, const float* y, const float* z,
+                                        size_t begin, size_t n, const PolygonPrism& prism, uint64_t* mask )
+{
+  for ( size_t word_begin=begin; word_begin<n; word_begin+=64 )
+  {
+    size_t word_end = word_begin + 64 < n ? word_begin + 64 : n;
+    uint64_t bits = 0;
+    for ( size_t i=word_begin; i<word_end; i++ )
+    {
+      bits |= (uint64_t)prism.contains( x[i], y[i], z[i] ) << ( i - word_begin );
+    }
+    mask[word_begin / 64] = bits;
+  }
+}
+
+#ifdef INTERACTIVE_MARKER_TUTORIALS_X86_KERNELS
+
+__attribute__(( target( "avx2" ) ))
+inline void classifyOrientedBoxAvx2( const float* x, const float* y, const float* z,
+                                     size_t n, const OrientedBox& box, uint64_t* mask )
+{
+  const __m256 abs_mask = _mm256_castsi256_ps( _mm256_set1_epi32( 0x7fffffff ) );
+  const __m256 cx = _mm256_set1_ps( box.center[0] );
+  const __m256 cy = _mm256_set1_ps( box.center[1] );
+  const __m256 cz = _mm256_set1_ps( box.center[2] );
+  __m256 a[3][3], half[3];
+  for ( int axis=0; axis<3; axis++ )
+  {
+    for ( int i=0; i<3; i++ )
+    {
+      a[axis][i] = _mm256_set1_ps( box.axes[axis][i] );
+    }
+    half[axis] = _mm256_set1_ps( box.half[axis] );
+  }
+
+  size_t full_words = n / 64;
+  for ( size_t w=0; w<full_words; w++ )
+  {
+    uint64_t bits = 0;
+    for ( size_t lane=0; lane<64; lane+=8 )
+    {
+      size_t i = w * 64 + lane;
+      __m256 dx = _mm256_sub_ps( _mm256_loadu_ps( x + i ), cx );
+      __m256 dy = _mm256_sub_ps( _mm256_loadu_ps( y + i ), cy );
+      __m256 dz = _mm256_sub_ps( _mm256_loadu_ps( z + i ), cz );
+      __m256 in = _mm256_castsi256_ps( _mm256_set1_epi32( -1 ) );
+      for ( int axis=0; axis<3; axis++ )
+      {
+        __m256 l = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( dx, a[axis][0] ), _mm256_mul_ps( dy, a[axis][1] ) ),
+                                  _mm256_mul_ps( dz, a[axis][2] ) );
+        in = _mm256_and_ps( in, _mm256_cmp_ps( _mm256_and_ps( l, abs_mask ), half[axis], _CMP_LE_OQ ) );
+      }
+      bits |= (uint64_t)_mm256_movemask_ps( in ) << lane;
+    }
+    mask[w] = bits;
+  }
+  classifyOrientedBoxScalar( x, y, z, full_words * 64, n, box, mask );
+}
+
+// Eight points at a time are run through all edges, keeping the
+// crossing parity in a register.
+__attribute__(( target( "avx2" ) ))
+inline void classifyPolygonPrismAvx2( const float* x, const float* y, const float* z,
+                                      size_t n, const PolygonPrism& prism, uint64_t* mask )
+{
+  size_t num_edges = prism.xs.size();
+  if ( num_edges == 0 )
+  {
+    classifyPolygonPrismScalar( x, y, z, 0, n, prism, mask );
+    return;
+  }
+
+  const __m256 min_z = _mm256_set1_ps( prism.min_z ), max_z = _mm256_set1_ps( prism.max_z );
+
+  size_t full_words = n / 64;
+  for ( size_t w=0; w<full_words; w++ )
+  {
+    uint64_t bits = 0;
+    for ( size_t lane=0; lane<64; lane+=8 )
+    {
+      size_t i = w * 64 + lane;
+      __m256 px = _mm256_loadu_ps( x + i );
+      __m256 py = _mm256_loadu_ps( y + i );
+      __m256 pz = _mm256_loadu_ps( z + i );
+
+      __m256 inside = _mm256_setzero_ps();
+      for ( size_t e=0, f=num_edges-1; e<num_edges; f=e++ )
+      {
+        __m256 ey = _mm256_set1_ps( prism.ys[e] );
+        __m256 straddles = _mm256_xor_ps( _mm256_cmp_ps( ey, py, _CMP_GT_OQ ),
+                                          _mm256_cmp_ps( _mm256_set1_ps( prism.ys[f] ), py, _CMP_GT_OQ ) );
+        __m256 cross_x = _mm256_add_ps( _mm256_set1_ps( prism.xs[e] ),
+                                        _mm256_mul_ps( _mm256_sub_ps( py, ey ), _mm256_set1_ps( prism.slope( e, f ) ) ) );
+        inside = _mm256_xor_ps( inside, _mm256_and_ps( straddles, _mm256_cmp_ps( px, cross_x, _CMP_LT_OQ ) ) );
+      }
+      inside = _mm256_and_ps( inside, _mm256_and_ps( _mm256_cmp_ps( min_z, pz, _CMP_LE_OQ ),
+                                                     _mm256_cmp_ps( pz, max_z, _CMP_LE_OQ ) ) );
+      bits |= (uint64_t)_mm256_movemask_ps( inside ) << lane;
+    }
+    mask[w] = bits;
+  }
+  classifyPolygonPrismScalar( x, y, z, full_words * 64, n, prism, mask );
+}
+
+#endif
+
+inline void OrientedBox::classify( const float* x, const float* y, const float* z, size_t n, uint64_t* mask ) const
+{
+#ifdef INTERACTIVE_MARKER_TUTORIALS_X86_KERNELS
+  if ( bestAabbKernel() == AABB_KERNEL_AVX2 )
+  {
+    classifyOrientedBoxAvx2( x, y, z, n, *this, mask );
+    return;
+  }
+#endif
+  classifyOrientedBoxScalar( x, y, z, 0, n, *this, mask );
+}
+
+inline void PolygonPrism::classify( const float* x, const float* y, const float* z, size_t n, uint64_t* mask ) const
+{
+#ifdef INTERACTIVE_MARKER_TUTORIALS_X86_KERNELS
+  if ( bestAabbKernel() == AABB_KERNEL_AVX2 )
+  {
+    classifyPolygonPrismAvx2( x, y, z, n, *this, mask );
+    return;
+  }
+#endif
+  classifyPolygonPrismScalar( x, y, z, 0, n, *this, mask );
+}
+
+} // end namespace interactive_marker_tutorials
+
+#endif // INTERACTIVE_MARKER_TUTORIALS_SELECTION_VOLUME_H
@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2011, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef INTERACTIVE_MARKER_TUTORIALS_SPATIAL_HASH_H
+#define INTERACTIVE_MARKER_TUTORIALS_SPATIAL_HASH_H
+
+#include <math.h>
+#include <stdint.h>
+
+#include <unordered_map>
+#include <vector>
+
+namespace interactive_marker_tutorials
+{
+
+// A uniform grid over points that move, for finding the points near a
+// position without visiting all of them.  Cells are hashed, so only
+// cells with points in them take memory, and points are kept by index
+// with their slot in their cell, so moving one to another cell is
+// constant time.
+class SpatialHash
+{
+public:
+  explicit SpatialHash( double cell_size ) : inv_cell_size_( 1.0 / cell_size ) {}
+
+  // Add point index at (x, y, z).  Indices are expected to count up
+  // from 0.
+  void insert( uint32_t index, double x, double y, double z )
+  {
+    if ( index >= cell_of_.size() )
+    {
+      cell_of_.resize( index + 1 );
+      slot_of_.resize( index + 1 );
+    }
+    add( index, key( x, y, z ) );
+  }
+
+  // Point index moved to (x, y, z).
+  void move( uint32_t index, double x, double y, double z )
+  {
+    uint64_t cell = key( x, y, z );
+    if ( cell != cell_of_[index] )
+    {
+      remove( index );
+      add( index, cell );
+    }
+  }
+
+  // Append the points in the cells that overlap the cube of half size
+  // radius around (x, y, z) to candidates, which is cleared first.
+  // Callers check the actual distance.
+  void query( double x, double y, double z, double radius, std::vector<uint32_t>& candidates ) const
+  {
+    candidates.clear();
+    int lo[3] = { cellCoord( x - radius ), cellCoord( y - radius ), cellCoord( z - radius ) };
+    int hi[3] = { cellCoord( x + radius ), cellCoord( y + radius ), cellCoord( z + radius ) };
+    for ( int cx=lo[0]; cx<=hi[0]; cx++ )
+    {
+      for ( int cy=lo[1]; cy<=hi[1]; cy++ )
+      {
+        for ( int cz=lo[2]; cz<=hi[2]; cz++ )
+        {
+          std::unordered_map<uint64_t, std::vector<uint32_t> >::const_iterator cell = cells_.find( pack( cx, cy, cz ) );
+          if ( cell != cells_.end() )
+          {
+            candidates.insert( candidates.end(), cell->second.begin(), cell->second.end() );
+          }
+        }
+      }
+    }
+  }
+
+private:
+  int cellCoord( double v ) const { return (int)floor( v * inv_cell_size_ ); }
+
+  // cell coordinates are packed into 21 bits each
+  static uint64_t pack( int cx, int cy, int cz )
+  {
+    const uint64_t mask = ( 1 << 21 ) - 1;
+    return ( (uint64_t)cx & mask ) << 42 | ( (uint64_t)cy & mask ) << 21 | ( (uint64_t)cz & mask );
+  }
+
+  uint64_t key( double x, double y, double z ) const
+  {
+    return pack( cellCoord( x ), cellCoord( y ), cellCoord( z ) );
+  }
+
+  void add( uint32_t index, uint64_t cell )
+  {
+    std::vector<uint32_t>& points = cells_[cell];
+    cell_of_[index] = cell;
+    slot_of_[index] = points.size();
+    points.push_back( index );
+  }
+
+  void remove( uint32_t index )
+  {
+    std::vector<uint32_t>& points = cells_[cell_of_[index]];
+    uint32_t last = points.back();
+    points[slot_of_[index]] = last;
+    slot_of_[last] = slot_of_[index];
+    points.pop_back();
+  }
+
+  double inv_cell_size_;
+  std::unordered_map<uint64_t, std::vector<uint32_t> > cells_;
+  std::vector<uint64_t> cell_of_;
+  std::vector<uint32_t> slot_of_;
+};
+
+} // end namespace interactive_marker_tutorials
+
+#endif // INTERACTIVE_MARKER_TUTORIALS_SPATIAL_HASH_H
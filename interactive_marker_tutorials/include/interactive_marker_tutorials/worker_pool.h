@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2011, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef INTERACTIVE_MARKER_TUTORIALS_WORKER_POOL_H
+#define INTERACTIVE_MARKER_TUTORIALS_WORKER_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread.hpp>
+
+namespace interactive_marker_tutorials
+{
+
+// A fixed set of threads for running data-parallel loops.
+//
+// The threads are started once and sleep between calls, so a parallel
+// loop costs a wakeup rather than a thread start.  The calling thread
+// takes part in the work, so a pool of size 1 has no extra threads and
+// runs everything inline.  parallelFor() must not be called from more
+// than one thread at a time.
+class WorkerPool : boost::noncopyable
+{
+public:
+  typedef boost::function<void( size_t )> Task;
+
+  // num_threads counts the calling thread; 0 means one per core.
+  explicit WorkerPool( unsigned num_threads = 0 ) :
+    task_( 0 ),
+    num_tasks_( 0 ),
+    next_task_( 0 ),
+    remaining_( 0 ),
+    generation_( 0 ),
+    stop_( false )
+  {
+    if ( num_threads == 0 )
+    {
+      num_threads = std::max( boost::thread::hardware_concurrency(), 1u );
+    }
+    for ( unsigned i=1; i<num_threads; i++ )
+    {
+      threads_.create_thread( boost::bind( &WorkerPool::workerLoop, this ) );
+    }
+  }
+
+  ~WorkerPool()
+  {
+    {
+      boost::mutex::scoped_lock lock( mutex_ );
+      stop_ = true;
+    }
+    work_cv_.notify_all();
+    threads_.join_all();
+  }
+
+  unsigned size() const { return threads_.size() + 1; }
+
+  // Call task(i) for every i in [0, num_tasks), spread over the pool,
+  // and return once all of them have finished.
+  void parallelFor( size_t num_tasks, const Task& task )
+  {
+    if ( threads_.size() == 0 || num_tasks <= 1 )
+    {
+      for ( size_t i=0; i<num_tasks; i++ )
+      {
+        task( i );
+      }
+      return;
+    }
+
+    {
+      boost::mutex::scoped_lock lock( mutex_ );
+      task_ = &task;
+      num_tasks_ = num_tasks;
+      next_task_ = 0;
+      remaining_ = num_tasks;
+      generation_++;
+    }
+    work_cv_.notify_all();
+
+    runTasks();
+
+    boost::mutex::scoped_lock lock( mutex_ );
+    while ( remaining_ > 0 )
+    {
+      done_cv_.wait( lock );
+    }
+    task_ = 0;
+  }
+
+private:
+  void runTasks()
+  {
+    while ( true )
+    {
+      size_t i;
+      const Task* task;
+      {
+        boost::mutex::scoped_lock lock( mutex_ );
+        if ( next_task_ >= num_tasks_ )
+        {
+          return;
+        }
+        i = next_task_++;
+        task = task_;
+      }
+
+      ( *task )( i );
+
+      boost::mutex::scoped_lock lock( mutex_ );
+      if ( --remaining_ == 0 )
+      {
+        done_cv_.notify_all();
+      }
+    }
+  }
+
+  void workerLoop()
+  {
+    uint64_t seen = 0;
+    while ( true )
+    {
+      {
+        boost::mutex::scoped_lock lock( mutex_ );
+        while ( !stop_ && generation_ == seen )
+        {
+          work_cv_.wait( lock );
+        }
+        if ( stop_ )
+        {
+          return;
+        }
+        seen = generation_;
+      }
+      runTasks();
+    }
+  }
+
+  boost::thread_group threads_;
+  boost::mutex mutex_;
+  boost::condition_variable work_cv_;
+  boost::condition_variable done_cv_;
+
+  const Task* task_;
+  size_t num_tasks_;
+  size_t next_task_;
+  size_t remaining_;
+  uint64_t generation_;
+  bool stop_;
+};
+
+} // end namespace interactive_marker_tutorials
+
+#endif // INTERACTIVE_MARKER_TUTORIALS_WORKER_POOL_H
@@ -34,19 +34,255 @@
 
 #include <math.h>
 
+#include <algorithm>
+
 #include <tf/LinearMath/Vector3.h>
 
+#include <boost/scoped_ptr.hpp>
+
+#include <interactive_marker_tutorials/cube_lattice.h>
+#include <interactive_marker_tutorials/lattice_relaxation.h>
+#include <interactive_marker_tutorials/spatial_hash.h>
+#include <interactive_marker_tutorials/worker_pool.h>
+
 
 using namespace visualization_msgs;
+using interactive_marker_tutorials::cube_lattice_step;
 
 boost::shared_ptr<interactive_markers::InteractiveMarkerServer> server;
 
 std::vector< tf::Vector3 > positions;
 
+// Dragging a cube pulls along the cubes around it with a weight of
+// 1 / (5 d + 1) - 0.2, which is zero from d = 0.8 on.  The grid finds
+// the cubes within that distance, so a drag doesn't visit all of them.
+// Cells of half the radius waste fewer candidates than cells of the
+// radius, for a few more cell lookups.
+const double falloff_radius = 0.8;
+interactive_marker_tutorials::SpatialHash grid( falloff_radius / 2 );
+std::vector< uint32_t > near_cubes;
+
+// The names of the markers, made once, and the positions the cubes were
+// last sent at.  Moved cubes are marked dirty and sent once per update,
+// and only if they moved more than min_move since they were last sent,
+// so the update messages only carry the cubes that visibly changed.
+// The cubes left behind by less than that are flushed when the drag ends
+// and when the relaxation comes to rest, so none stays off for good.
+std::vector< std::string > names;
+std::vector< tf::Vector3 > sent_positions;
+std::vector< uint32_t > dirty;
+std::vector< bool > is_dirty;
+const double min_move = 1e-4;
+bool flushed = true;
+
+// With ~relaxation_iterations set, the lattice is a deformable object
+// instead: dragging a cube holds it, springs between neighbouring cubes
+// pull the others along, and a timer relaxes the springs at a fixed
+// rate, independent of how often feedback arrives.
+boost::scoped_ptr<interactive_marker_tutorials::LatticeRelaxation> relaxation;
+boost::scoped_ptr<interactive_marker_tutorials::WorkerPool> pool;
+int relaxation_iterations = 0;
+
+// With ~instanced set, the cubes are drawn as CUBE_LIST blocks of
+// ~block_size^3 cubes, one interactive marker per block instead of one
+// per cube.  The grid finds the cube under the mouse when a block is
+// grabbed.  Dragging moves the whole block on the client, so while the
+// block of the dragged cube follows the drag only its pose is sent; when
+// it is let go it goes back to the origin, with its points where its
+// cubes ended up.  The other blocks stay at the origin and are sent
+// again whole when any of their cubes moved.
+bool instanced = false;
+std::vector< visualization_msgs::InteractiveMarker > blocks;
+std::vector< std::vector<uint32_t> > block_cubes;
+std::vector< uint32_t > block_of;
+std::vector< uint32_t > dirty_blocks;
+std::vector< bool > is_dirty_block;
+int grabbed = -1;
+unsigned grabbed_block = 0;
+tf::Vector3 grab_start;
+
+tf::Vector3 block_offset( unsigned b )
+{
+  const geometry_msgs::Point& p = blocks[b].pose.position;
+  return tf::Vector3( p.x, p.y, p.z );
+}
+
+void markDirty( unsigned i )
+{
+  if ( !is_dirty[i] )
+  {
+    is_dirty[i] = true;
+    dirty.push_back( i );
+  }
+}
+
+void setPosition( unsigned i )
+{
+  grid.move( i, positions[i].x(), positions[i].y(), positions[i].z() );
+  markDirty( i );
+}
+
+void markBlockDirty( unsigned b )
+{
+  if ( !is_dirty_block[b] )
+  {
+    is_dirty_block[b] = true;
+    dirty_blocks.push_back( b );
+  }
+}
+
+// Send the dirty blocks again, with their points where their cubes are.
+void sendBlocks()
+{
+  for ( unsigned n=0; n<dirty_blocks.size(); n++ )
+  {
+    unsigned b = dirty_blocks[n];
+    is_dirty_block[b] = false;
+
+    tf::Vector3 offset = block_offset( b );
+    std::vector<geometry_msgs::Point>& points = blocks[b].controls[0].markers[0].points;
+    for ( unsigned j=0; j<points.size(); j++ )
+    {
+      const tf::Vector3& p = positions[ block_cubes[b][j] ];
+      points[j].x = p.x() - offset.x();
+      points[j].y = p.y() - offset.y();
+      points[j].z = p.z() - offset.z();
+    }
+    // keeps the callback
+    server->insert( blocks[b] );
+  }
+  dirty_blocks.clear();
+}
+
+// Send the dirty cubes, returns how many cubes were sent.  Unless flush
+// is set, cubes that moved less than min_move are left for later.
+unsigned sendMoved( bool flush = false )
+{
+  unsigned sent = 0;
+  for ( unsigned n=0; n<dirty.size(); n++ )
+  {
+    unsigned i = dirty[n];
+    is_dirty[i] = false;
+    if ( flush ? positions[i] == sent_positions[i] :
+         positions[i].distance2( sent_positions[i] ) < min_move*min_move ) continue;
+
+    if ( instanced )
+    {
+      // the dragged block is sent when it is let go
+      if ( grabbed >= 0 && block_of[i] == grabbed_block ) continue;
+      markBlockDirty( block_of[i] );
+      sent_positions[i] = positions[i];
+      sent++;
+      continue;
+    }
+
+    geometry_msgs::Pose pose;
+    pose.position.x = positions[i].x();
+    pose.position.y = positions[i].y();
+    pose.position.z = positions[i].z();
+    server->setPose( names[i], pose );
+
+    sent_positions[i] = positions[i];
+    sent++;
+  }
+  dirty.clear();
+  sendBlocks();
+  return sent;
+}
+
+// Send every cube that isn't where it was last sent, however little it
+// moved.
+unsigned flushMoved()
+{
+  for ( unsigned i=0; i<positions.size(); i++ )
+  {
+    if ( positions[i] != sent_positions[i] )
+    {
+      markDirty( i );
+    }
+  }
+  flushed = true;
+  return sendMoved( true );
+}
+
+// One frame of the relaxation: a fixed number of iterations, then the
+// cubes that moved are sent.  The first frame that moves no cube by
+// min_move flushes the rest.
+void simulate( const ros::TimerEvent& )
+{
+  relaxation->relax( *pool, relaxation_iterations );
+  for ( unsigned i=0; i<positions.size(); i++ )
+  {
+    positions[i] = relaxation->position( i );
+    if ( positions[i].distance2( sent_positions[i] ) >= min_move*min_move )
+    {
+      setPosition( i );
+    }
+  }
+  if ( sendMoved() > 0 )
+  {
+    flushed = false;
+    server->applyChanges();
+  }
+  else if ( !flushed && flushMoved() > 0 )
+  {
+    server->applyChanges();
+  }
+}
+
 void processFeedback( const visualization_msgs::InteractiveMarkerFeedbackConstPtr &feedback )
 {
   switch ( feedback->event_type )
   {
+    case visualization_msgs::InteractiveMarkerFeedback::MOUSE_DOWN:
+    {
+      grabbed = -1;
+      if ( !instanced || !feedback->mouse_point_valid )
+      {
+        break;
+      }
+
+      // the cube under the mouse is the one closest to the clicked point
+      unsigned block = atoi( feedback->marker_name.c_str() );
+      tf::Vector3 hit( feedback->mouse_point.x, feedback->mouse_point.y, feedback->mouse_point.z );
+      grid.query( hit.x(), hit.y(), hit.z(), cube_lattice_step, near_cubes );
+      double best = cube_lattice_step*cube_lattice_step;
+      for ( unsigned n=0; n<near_cubes.size(); n++ )
+      {
+        double d = hit.distance2( positions[ near_cubes[n] ] );
+        if ( block_of[ near_cubes[n] ] == block && d < best )
+        {
+          best = d;
+          grabbed = near_cubes[n];
+        }
+      }
+      if ( grabbed >= 0 )
+      {
+        grabbed_block = block;
+        grab_start = positions[grabbed];
+      }
+      return;
+    }
+
+    case visualization_msgs::InteractiveMarkerFeedback::MOUSE_UP:
+    {
+      if ( relaxation )
+      {
+        relaxation->release();
+      }
+      grabbed = -1;
+      unsigned block = atoi( feedback->marker_name.c_str() );
+      if ( instanced && block < blocks.size() )
+      {
+        // back to the origin, with the points where the cubes are, even
+        // if no cube was grabbed and the block was dragged for nothing
+        blocks[block].pose.position = geometry_msgs::Point();
+        markBlockDirty( block );
+      }
+      flushMoved();
+      break;
+    }
+
     case visualization_msgs::InteractiveMarkerFeedback::POSE_UPDATE:
     {
       //compute difference vector for this cube
@@ -54,36 +290,59 @@ void processFeedback( const visualization_msgs::InteractiveMarkerFeedbackConstPt
       tf::Vector3 fb_pos(feedback->pose.position.x, feedback->pose.position.y, feedback->pose.position.z);
       unsigned index = atoi( feedback->marker_name.c_str() );
 
-      if ( index > positions.size() )
+      if ( instanced )
+      {
+        // the pose is the block's, which started at the origin
+        if ( index < blocks.size() )
+        {
+          blocks[index].pose.position = feedback->pose.position;
+          server->setPose( blocks[index].name, blocks[index].pose );
+        }
+        if ( grabbed < 0 )
+        {
+          break;
+        }
+        index = grabbed;
+        fb_pos = grab_start + fb_pos;
+      }
+
+      if ( index >= positions.size() )
       {
         return;
       }
+
+      if ( relaxation )
+      {
+        // the simulation moves the others
+        relaxation->grab( index, fb_pos );
+        break;
+      }
+
       tf::Vector3 fb_delta = fb_pos - positions[index];
 
-      // move all markers in that direction
-      for ( unsigned i=0; i<positions.size(); i++ )
+      // move all markers in range in that direction
+      grid.query( fb_pos.x(), fb_pos.y(), fb_pos.z(), falloff_radius, near_cubes );
+      for ( unsigned n=0; n<near_cubes.size(); n++ )
       {
+        unsigned i = near_cubes[n];
+        if ( i == index ) continue;
+
         float d = fb_pos.distance( positions[i] );
         float t = 1 / (d*5.0+1.0) - 0.2;
-        if ( t < 0.0 ) t=0.0;
+        if ( t <= 0.0 ) continue;
 
         positions[i] += t * fb_delta;
-
-        if ( i == index ) {
-          ROS_INFO_STREAM( d );
-          positions[i] = fb_pos;
-        }
-
-        geometry_msgs::Pose pose;
-        pose.position.x = positions[i].x();
-        pose.position.y = positions[i].y();
-        pose.position.z = positions[i].z();
-
-        std::stringstream s;
-        s << i;
-        server->setPose( s.str(), pose );
+        setPosition( i );
       }
 
+      // the dragged marker is where the feedback says, even if it moved
+      // out of range since the last update
+      float d = fb_pos.distance( positions[index] );
+      positions[index] = fb_pos;
+      setPosition( index );
+
+      unsigned sent = sendMoved();
+      ROS_INFO( "%u moved %f, sent %u cubes", index, d, sent );
 
       break;
     }
@@ -91,69 +350,51 @@ void processFeedback( const visualization_msgs::InteractiveMarkerFeedbackConstPt
   server->applyChanges();
 }
 
-InteractiveMarkerControl& makeBoxControl( InteractiveMarker &msg )
-{
-  InteractiveMarkerControl control;
-  control.always_visible = true;
-  control.orientation_mode = InteractiveMarkerControl::VIEW_FACING;
-  control.interaction_mode = InteractiveMarkerControl::MOVE_PLANE;
-  control.independent_marker_orientation = true;
-
-  Marker marker;
-
-  marker.type = Marker::CUBE;
-  marker.scale.x = msg.scale;
-  marker.scale.y = msg.scale;
-  marker.scale.z = msg.scale;
-  marker.color.r = 0.65+0.7*msg.pose.position.x;
-  marker.color.g = 0.65+0.7*msg.pose.position.y;
-  marker.color.b = 0.65+0.7*msg.pose.position.z;
-  marker.color.a = 1.0;
-
-  control.markers.push_back( marker );
-  msg.controls.push_back( control );
-
-  return msg.controls.back();
-}
-
-
-void makeCube( )
+// A cube of side_length^3 cubes, each inserted as soon as it is made.
+void makeCube( int side_length )
 {
-  int side_length = 10;
-  float step = 1.0/ (float)side_length;
-  int count = 0;
-
   positions.reserve( side_length*side_length*side_length );
+  names.reserve( side_length*side_length*side_length );
 
-  for ( double x=-0.5; x<0.5; x+=step )
-  {
-    for ( double y=-0.5; y<0.5; y+=step )
-    {
-      for ( double z=0.0; z<1.0; z+=step )
+  interactive_marker_tutorials::makeCubeLattice( side_length,
+      []( const InteractiveMarker& int_marker )
       {
-        InteractiveMarker int_marker;
-        int_marker.header.frame_id = "base_link";
-        int_marker.scale = step;
-
-        int_marker.pose.position.x = x;
-        int_marker.pose.position.y = y;
-        int_marker.pose.position.z = z;
-
-        positions.push_back( tf::Vector3(x,y,z) );
-
-        std::stringstream s;
-        s << count;
-        int_marker.name = s.str();
-
-        makeBoxControl(int_marker);
-
-        server->insert( int_marker );
-        server->setCallback( int_marker.name, &processFeedback );
+        const geometry_msgs::Point& p = int_marker.pose.position;
+        grid.insert( positions.size(), p.x, p.y, p.z );
+        positions.push_back( tf::Vector3(p.x,p.y,p.z) );
+        names.push_back( int_marker.name );
+        server->insert( int_marker, &processFeedback );
+      } );
+}
 
-        count++;
-      }
-    }
-  }
+// The same cube in CUBE_LIST blocks of block_size^3 cubes.  The blocks
+// are kept, as they are sent again whole when their cubes move.
+void makeInstancedCube( int side_length, int block_size )
+{
+  unsigned num_cubes = side_length*side_length*side_length;
+  positions.resize( num_cubes );
+  block_of.resize( num_cubes );
+  unsigned per_side = ( side_length + block_size - 1 ) / block_size;
+  blocks.reserve( per_side*per_side*per_side );
+  block_cubes.reserve( per_side*per_side*per_side );
+
+  interactive_marker_tutorials::makeCubeLatticeBlocks( side_length, block_size,
+      []( const InteractiveMarker& int_marker, const std::vector<uint32_t>& cubes )
+      {
+        unsigned b = blocks.size();
+        const std::vector<geometry_msgs::Point>& points = int_marker.controls[0].markers[0].points;
+        for ( unsigned j=0; j<points.size(); j++ )
+        {
+          unsigned i = cubes[j];
+          positions[i] = tf::Vector3( points[j].x, points[j].y, points[j].z );
+          grid.insert( i, points[j].x, points[j].y, points[j].z );
+          block_of[i] = b;
+        }
+        blocks.push_back( int_marker );
+        block_cubes.push_back( cubes );
+        server->insert( int_marker, &processFeedback );
+      } );
+  is_dirty_block.resize( blocks.size(), false );
 }
 
 int main(int argc, char** argv)
@@ -164,12 +405,55 @@ int main(int argc, char** argv)
 
   ros::Duration(0.1).sleep();
 
+  // ~side_length            cubes per side (default: 10)
+  // ~relaxation_iterations  spring iterations per frame, 0 moves the
+  //                         cubes around a dragged one directly instead
+  //                         (default: 0)
+  // ~simulation_rate        relaxation frames per second (default: 30)
+  // ~num_threads            threads for the relaxation, 0 for one per
+  //                         core (default: 0)
+  // ~instanced              draw the cubes as CUBE_LIST blocks instead
+  //                         of one marker each (default: false)
+  // ~block_size             cubes per side of a block (default: 5)
+  ros::NodeHandle private_nh( "~" );
+  int side_length, num_threads, block_size;
+  double simulation_rate;
+  private_nh.param( "side_length", side_length, 10 );
+  private_nh.param( "relaxation_iterations", relaxation_iterations, 0 );
+  private_nh.param( "simulation_rate", simulation_rate, 30.0 );
+  private_nh.param( "num_threads", num_threads, 0 );
+  private_nh.param( "instanced", instanced, false );
+  private_nh.param( "block_size", block_size, 5 );
+  side_length = std::max( side_length, 1 );
+  block_size = std::max( block_size, 1 );
+
   ROS_INFO("initializing..");
-  makeCube();
+  ros::WallTime start = ros::WallTime::now();
+  if ( instanced )
+  {
+    makeInstancedCube( side_length, block_size );
+  }
+  else
+  {
+    makeCube( side_length );
+  }
   server->applyChanges();
-  ROS_INFO("ready.");
+  sent_positions = positions;
+  is_dirty.resize( positions.size(), false );
+  ROS_INFO("ready, %zu cubes in %.1f ms.", positions.size(), ( ros::WallTime::now() - start ).toSec() * 1e3 );
+
+  ros::Timer simulation_timer;
+  if ( relaxation_iterations > 0 && simulation_rate > 0 )
+  {
+    relaxation.reset( new interactive_marker_tutorials::LatticeRelaxation( side_length, positions ) );
+    pool.reset( new interactive_marker_tutorials::WorkerPool( std::max( num_threads, 0 ) ) );
+    ros::NodeHandle nh;
+    simulation_timer = nh.createTimer( ros::Duration( 1.0 / simulation_rate ), &simulate );
+  }
 
   ros::spin();
 
+  simulation_timer.stop();
+  pool.reset();
   server.reset();
 }
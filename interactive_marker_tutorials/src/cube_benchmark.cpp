@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2011, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+// Start-up time of the cube tutorial for 10^3 to 10^5 cubes: making the
+// markers, inserting them into a server and sending the first update,
+// one marker per cube against the CUBE_LIST blocks of cube.cpp's
+// ~instanced mode.  The server advertises its topics, so unlike the
+// other benchmarks this one needs a ROS master:
+//
+//   rosrun interactive_marker_tutorials cube_benchmark
+
+#include <stdio.h>
+
+#include <benchmark/benchmark.h>
+
+#include <ros/ros.h>
+
+#include <boost/scoped_ptr.hpp>
+
+#include <interactive_markers/interactive_marker_server.h>
+
+#include <interactive_marker_tutorials/cube_lattice.h>
+
+namespace vm = visualization_msgs;
+
+namespace
+{
+
+void processFeedback( const vm::InteractiveMarkerFeedbackConstPtr& )
+{
+}
+
+// One marker per cube, made and inserted as cube.cpp does without
+// ~instanced.
+void BM_CubeStartupOneByOne( benchmark::State& state )
+{
+  int side_length = state.range( 0 );
+  for ( auto _ : state )
+  {
+    // the server's topics are not part of the start-up
+    state.PauseTiming();
+    boost::scoped_ptr<interactive_markers::InteractiveMarkerServer> server(
+        new interactive_markers::InteractiveMarkerServer( "cube_benchmark" ) );
+    state.ResumeTiming();
+
+    interactive_marker_tutorials::makeCubeLattice( side_length,
+        [&server]( const vm::InteractiveMarker& int_marker )
+        {
+          server->insert( int_marker, &processFeedback );
+        } );
+    server->applyChanges();
+
+    state.PauseTiming();
+    server.reset();
+    state.ResumeTiming();
+  }
+  state.counters["markers"] = side_length * side_length * side_length;
+}
+
+// The same cubes as CUBE_LIST blocks of 5^3, as cube.cpp draws them
+// with ~instanced.
+void BM_CubeStartupBlocks( benchmark::State& state )
+{
+  int side_length = state.range( 0 );
+  unsigned blocks = 0;
+  for ( auto _ : state )
+  {
+    state.PauseTiming();
+    boost::scoped_ptr<interactive_markers::InteractiveMarkerServer> server(
+        new interactive_markers::InteractiveMarkerServer( "cube_benchmark" ) );
+    state.ResumeTiming();
+
+    blocks = 0;
+    interactive_marker_tutorials::makeCubeLatticeBlocks( side_length, 5,
+        [&server, &blocks]( const vm::InteractiveMarker& int_marker, const std::vector<uint32_t>& )
+        {
+          server->insert( int_marker, &processFeedback );
+          blocks++;
+        } );
+    server->applyChanges();
+
+    state.PauseTiming();
+    server.reset();
+    state.ResumeTiming();
+  }
+  state.counters["markers"] = blocks;
+}
+
+} // namespace
+
+// 1000, 10648 and 103823 cubes
+BENCHMARK( BM_CubeStartupOneByOne )->Arg( 10 )->Arg( 22 )->Arg( 47 )->Unit( benchmark::kMillisecond );
+BENCHMARK( BM_CubeStartupBlocks )->Arg( 10 )->Arg( 22 )->Arg( 47 )->Unit( benchmark::kMillisecond );
+
+int main( int argc, char** argv )
+{
+  ros::init( argc, argv, "cube_benchmark", ros::init_options::AnonymousName | ros::init_options::NoSigintHandler );
+  benchmark::Initialize( &argc, argv );
+  if ( !ros::master::check() )
+  {
+    fprintf( stderr, "cube_benchmark needs a ROS master\n" );
+    return 1;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2011, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+// Writes a point file (see point_file.h) for the selection tutorial's
+// ~point_file parameter.  The points are generated and written one at a
+// time, so files of any size can be made without the memory to hold them:
+//
+//   rosrun interactive_marker_tutorials make_point_file points.bin 100000000
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <interactive_marker_tutorials/point_file.h>
+
+int main(int argc, char** argv)
+{
+  if ( argc != 3 )
+  {
+    fprintf( stderr, "usage: %s <file> <number of points>\n", argv[0] );
+    return 1;
+  }
+
+  long long num_points = atoll( argv[2] );
+  interactive_marker_tutorials::PointFileWriter writer;
+  if ( num_points < 0 || !writer.open( argv[1] ) )
+  {
+    fprintf( stderr, "could not write %s\n", argv[1] );
+    return 1;
+  }
+
+  // the same surface as makePoints() in surface_points.h
+  double radius = 3;
+  double scale = 0.2;
+  for ( long long i=0; i<num_points; i++ )
+  {
+    double x = scale * ( -radius + 2 * radius * rand() / (double)RAND_MAX );
+    double y = scale * ( -radius + 2 * radius * rand() / (double)RAND_MAX );
+    double z = scale * radius * 0.2 * ( sin( 10.0 / radius * x ) + cos( 10.0 / radius * y ) );
+    writer.append( x, y, z );
+  }
+
+  if ( !writer.close() )
+  {
+    fprintf( stderr, "could not write %s\n", argv[1] );
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2011, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+// Counterpart of the point_cloud tutorial when run with ~encoding set.
+// Decodes the PointChunk messages back into plain markers and
+// republishes them for a Marker display, one sub-marker per chunk.
+
+#include <ros/ros.h>
+
+#include <visualization_msgs/Marker.h>
+
+#include <interactive_marker_tutorials/PointChunk.h>
+#include <interactive_marker_tutorials/point_encoding.h>
+
+class PointChunkClient
+{
+public:
+  PointChunkClient() :
+    nh_( "point_cloud" )
+  {
+    chunk_sub_ = nh_.subscribe( "chunks", 100, &PointChunkClient::chunkCallback, this );
+    marker_pub_ = nh_.advertise<visualization_msgs::Marker>( "decoded", 100 );
+  }
+
+  void chunkCallback( const interactive_marker_tutorials::PointChunkConstPtr& chunk )
+  {
+    ros::WallTime start = ros::WallTime::now();
+    visualization_msgs::Marker marker;
+    if ( !interactive_marker_tutorials::decodeMarker( *chunk, marker ) )
+    {
+      ROS_WARN( "dropping malformed chunk %d of %s", chunk->marker.id, chunk->marker.ns.c_str() );
+      return;
+    }
+    ROS_DEBUG( "decoded %u points of %s from %zu bytes in %.2f ms",
+               chunk->num_points, chunk->marker.ns.c_str(), chunk->data.size(),
+               ( ros::WallTime::now() - start ).toSec() * 1e3 );
+    marker_pub_.publish( marker );
+  }
+
+private:
+  ros::NodeHandle nh_;
+  ros::Subscriber chunk_sub_;
+  ros::Publisher marker_pub_;
+};
+
+int main(int argc, char** argv)
+{
+  ros::init(argc, argv, "point_chunk_client");
+
+  PointChunkClient client;
+
+  ros::spin();
+}
@@ -30,13 +30,104 @@
 
 // %Tag(fullSource)%
 #include <math.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <map>
+#include <sstream>
+#include <string>
 
 #include <ros/ros.h>
+#include <ros/serialization.h>
+
+#include <boost/bind.hpp>
+#include <boost/scoped_ptr.hpp>
 
 #include <interactive_markers/interactive_marker_server.h>
 
+#include <interactive_marker_tutorials/PointChunk.h>
+#include <interactive_marker_tutorials/color_palette.h>
+#include <interactive_marker_tutorials/point_encoding.h>
+#include <interactive_marker_tutorials/point_kd_tree.h>
+
+using interactive_marker_tutorials::ColorPalette;
+using interactive_marker_tutorials::PointChunk;
+using interactive_marker_tutorials::PointKdTree;
+
 namespace vm = visualization_msgs;
 
+// The points of a marker as a cloud for PointKdTree, without copying
+// them.
+class MarkerPointCloud
+{
+public:
+  MarkerPointCloud( const std::vector<geometry_msgs::Point>& points ) : points_( points ) {}
+
+  size_t size() const { return points_.size(); }
+  float x( size_t i ) const { return points_[i].x; }
+  float y( size_t i ) const { return points_[i].y; }
+  float z( size_t i ) const { return points_[i].z; }
+
+private:
+  const std::vector<geometry_msgs::Point>& points_;
+};
+
+// The points of the markers with an index over them, so that clicks
+// can be turned into the point that was clicked.  RViz only reports
+// where the click hit, in mouse_point.
+//
+// Markers with the same number of points show the same helix, so the
+// points and their index are made once per point count and shared by
+// the picking of all of them.  Every marker still carries its own copy
+// of the points: a Marker message holds its points by value and can't
+// refer to a shared buffer, and the server keeps one more copy of every
+// marker it sends.
+struct PickablePoints
+{
+  std::vector<geometry_msgs::Point> points;
+  PointKdTree tree;
+};
+
+std::map<int, PickablePoints> helix_cache;
+std::map<std::string, const PickablePoints*> pickable_points;
+
+void makePoints( std::vector<geometry_msgs::Point>& points_out, int num_points );
+
+const PickablePoints& helixPoints( int num_points )
+{
+  PickablePoints& helix = helix_cache[num_points];
+  if ( (int)helix.points.size() != num_points )
+  {
+    makePoints( helix.points, num_points );
+    helix.tree.build( MarkerPointCloud( helix.points ) );
+  }
+  return helix;
+}
+
+// Index of the point of a marker closest to where a click hit it, or
+// -1 if we don't know the marker.
+int pickPoint( const vm::InteractiveMarkerFeedback& feedback )
+{
+  std::map<std::string, const PickablePoints*>::const_iterator it = pickable_points.find( feedback.marker_name );
+  if ( it == pickable_points.end() )
+  {
+    return -1;
+  }
+
+  // the points are relative to the marker pose, which only ever moves
+  // along x
+  uint32_t index;
+  const PickablePoints& pickable = *it->second;
+  if ( !pickable.tree.nearest( MarkerPointCloud( pickable.points ),
+                                 feedback.mouse_point.x - feedback.pose.position.x,
+                                 feedback.mouse_point.y - feedback.pose.position.y,
+                                 feedback.mouse_point.z - feedback.pose.position.z, index ) )
+  {
+    return -1;
+  }
+  return index;
+}
+
 void processFeedback( const vm::InteractiveMarkerFeedbackConstPtr &feedback )
 {
   uint8_t type = feedback->event_type;
@@ -50,10 +141,14 @@ void processFeedback( const vm::InteractiveMarkerFeedbackConstPtr &feedback )
 
     if( feedback->mouse_point_valid )
     {
-      ROS_INFO( "%s at %f, %f, %f in frame %s",
+      ros::WallTime start = ros::WallTime::now();
+      int index = pickPoint( *feedback );
+      double us = ( ros::WallTime::now() - start ).toSec() * 1e6;
+
+      ROS_INFO( "%s at %f, %f, %f in frame %s, on point %d (found in %.1f us)",
                 type_str,
                 feedback->mouse_point.x, feedback->mouse_point.y, feedback->mouse_point.z,
-                feedback->header.frame_id.c_str() );
+                feedback->header.frame_id.c_str(), index, us );
     }
     else
     {
@@ -68,30 +163,77 @@ void processFeedback( const vm::InteractiveMarkerFeedbackConstPtr &feedback )
   }
 }
 
+// A helix of 25 turns, 10 m high.
+//
+// The angle advances by the same step from point to point, so cos and
+// sin of the offsets within a block are tabulated once, and each point
+// is the start of its block rotated by its offset.  That leaves two
+// trig calls per block instead of two per point, and an inner loop
+// without calls that the compiler vectorizes.
 void makePoints( std::vector<geometry_msgs::Point>& points_out, int num_points )
 {
+  const int block_size = 1024;
   double radius = 3;
+  double angle_step = 50 * M_PI / num_points;
+  double height_step = 10.0 / num_points;
+
+  double cos_offset[block_size], sin_offset[block_size];
+  for( int k = 0; k < block_size; k++ )
+  {
+    cos_offset[k] = cos( k * angle_step );
+    sin_offset[k] = sin( k * angle_step );
+  }
+
   points_out.resize(num_points);
-  for( int i = 0; i < num_points; i++ )
+  for( int block = 0; block < num_points; block += block_size )
   {
-    double angle = (i / (double) num_points * 50 * M_PI);
-    double height = (i / (double) num_points * 10);
-    points_out[i].x = radius * cos( angle );
-    points_out[i].y = radius * sin( angle );
-    points_out[i].z = height;
+    double c = radius * cos( block * angle_step );
+    double s = radius * sin( block * angle_step );
+    int n = std::min( block_size, num_points - block );
+    geometry_msgs::Point* p = &points_out[block];
+    for( int k = 0; k < n; k++ )
+    {
+      p[k].x = c * cos_offset[k] - s * sin_offset[k];
+      p[k].y = s * cos_offset[k] + c * sin_offset[k];
+      p[k].z = ( block + k ) * height_step;
+    }
   }
 }
 
-vm::InteractiveMarker makeMarker( std::string name, std::string description, int32_t type, float x, int num_points = 10000, float scale = 0.1f )
+// The palette colors the points by their height on the helix, from its
+// bottom at 0 to its top at 10.
+struct HelixHeight
+{
+  HelixHeight( const std::vector<geometry_msgs::Point>& points ) : points( points ) {}
+  float operator()( size_t i ) const { return points[i].z; }
+  const std::vector<geometry_msgs::Point>& points;
+};
+
+const float helix_bottom = 0.0f;
+const float helix_top = 10.0f;
+
+// With a palette, the points are colored by their height on the helix.
+//
+// The controls and the points marker are built in place, so the helix
+// is copied into the marker once and not again with every push_back.
+vm::InteractiveMarker makeMarker( std::string name, std::string description, int32_t type, float x, int num_points = 10000, float scale = 0.1f,
+                                  const ColorPalette* palette = 0 )
 {
   // create an interactive marker for our server
   vm::InteractiveMarker int_marker;
   int_marker.header.frame_id = "base_link";
   int_marker.name = name;
   int_marker.description = description;
+  int_marker.controls.resize( 2 );
+
+  // create a control which contains the point cloud which acts like a button.
+  vm::InteractiveMarkerControl& points_control = int_marker.controls[0];
+  points_control.always_visible = true;
+  points_control.interaction_mode = vm::InteractiveMarkerControl::BUTTON;
 
   // create a point cloud marker
-  vm::Marker points_marker;
+  points_control.markers.resize( 1 );
+  vm::Marker& points_marker = points_control.markers[0];
   points_marker.type = type;
   points_marker.scale.x = scale;
   points_marker.scale.y = scale;
@@ -100,50 +242,384 @@ vm::InteractiveMarker makeMarker( std::string name, std::string description, int
   points_marker.color.g = 0.5;
   points_marker.color.b = 0.5;
   points_marker.color.a = 1.0;
-  makePoints( points_marker.points, num_points );
-
-  // create a control which contains the point cloud which acts like a button.
-  vm::InteractiveMarkerControl points_control;
-  points_control.always_visible = true;
-  points_control.interaction_mode = vm::InteractiveMarkerControl::BUTTON;
-  points_control.markers.push_back( points_marker );
-
-  // add the control to the interactive marker
-  int_marker.controls.push_back( points_control );
+  points_marker.points = helixPoints( num_points ).points;
+  if( palette )
+  {
+    palette->map( HelixHeight( points_marker.points ), points_marker.points.size(), helix_bottom, helix_top,
+                  points_marker.colors );
+  }
 
   // create a control which will move the box
   // this control does not contain any markers,
   // which will cause RViz to insert two arrows
-  vm::InteractiveMarkerControl rotate_control;
+  vm::InteractiveMarkerControl& rotate_control = int_marker.controls[1];
   rotate_control.name = "move_x";
   rotate_control.interaction_mode =
       vm::InteractiveMarkerControl::MOVE_AXIS;
 
-  // add the control to the interactive marker
-  int_marker.controls.push_back(rotate_control);
-
   int_marker.pose.position.x = x;
 
   return int_marker;
 }
 
+void insertPickable( interactive_markers::InteractiveMarkerServer& server, const vm::InteractiveMarker& int_marker )
+{
+  pickable_points[int_marker.name] = &helixPoints( int_marker.controls[0].markers[0].points.size() );
+  server.insert( int_marker, &processFeedback );
+}
+
+// Sends the points of markers as PointChunk messages instead of through
+// the server, see point_chunk_client.  The chunks are encoded once and
+// sent again to every new subscriber, as they are all needed to show
+// the markers.  With a palette, the points are colored by height as
+// makeMarker colors them, but through a byte per point in the chunks.
+class ChunkPublisher
+{
+public:
+  ChunkPublisher( uint8_t encoding, bool compress, size_t chunk_bytes, const ColorPalette* palette = 0 ) :
+    encoding_( encoding ),
+    compress_( compress ),
+    chunk_bytes_( chunk_bytes ),
+    palette_( palette ),
+    bytes_( 0 ),
+    plain_bytes_( 0 )
+  {
+  }
+
+  // Take the points control out of an interactive marker and add its
+  // points to the chunks, in the frame of the interactive marker at its
+  // current pose.
+  void takePoints( vm::InteractiveMarker& int_marker )
+  {
+    vm::Marker& points_marker = int_marker.controls[0].markers[0];
+    points_marker.header = int_marker.header;
+    points_marker.ns = int_marker.name;
+    points_marker.pose = int_marker.pose;
+    plain_bytes_ += ros::serialization::serializationLength( points_marker );
+
+    std::vector<PointChunk> chunks;
+    std::vector<uint8_t> color_indices;
+    if( palette_ && palette_->index( HelixHeight( points_marker.points ), points_marker.points.size(),
+                                     helix_bottom, helix_top, color_indices ) )
+    {
+      // the colors a plain marker would carry
+      plain_bytes_ += points_marker.points.size() * ros::serialization::serializationLength( std_msgs::ColorRGBA() );
+      interactive_marker_tutorials::encodeMarker( points_marker, encoding_, compress_, chunk_bytes_,
+                                                  palette_->table(), color_indices, chunks );
+    }
+    else
+    {
+      interactive_marker_tutorials::encodeMarker( points_marker, encoding_, compress_, chunk_bytes_, chunks );
+    }
+    for( unsigned i = 0; i < chunks.size(); i++ )
+    {
+      bytes_ += ros::serialization::serializationLength( chunks[i] );
+      chunks_.push_back( chunks[i] );
+    }
+
+    int_marker.controls.erase( int_marker.controls.begin() );
+  }
+
+  void advertise()
+  {
+    ROS_INFO( "sending %zu point chunks, %.2f MB instead of %.2f MB",
+              chunks_.size(), bytes_ / 1e6, plain_bytes_ / 1e6 );
+    ros::NodeHandle nh( "point_cloud" );
+    pub_ = nh.advertise<PointChunk>( "chunks", std::max<size_t>( chunks_.size(), 1 ),
+                                     boost::bind( &ChunkPublisher::connect, this, _1 ) );
+  }
+
+private:
+  void connect( const ros::SingleSubscriberPublisher& pub )
+  {
+    for( unsigned i = 0; i < chunks_.size(); i++ )
+    {
+      pub.publish( chunks_[i] );
+    }
+  }
+
+  uint8_t encoding_;
+  bool compress_;
+  size_t chunk_bytes_;
+  const ColorPalette* palette_;
+  std::vector<PointChunk> chunks_;
+  double bytes_;
+  double plain_bytes_;
+  ros::Publisher pub_;
+};
+
+// Republishes markers through the server at a fixed rate, for sizing
+// server deployments.  Every interval it reports the update messages
+// (one per applyChanges()) and markers per second, the serialized
+// marker data per second and percentiles of the applyChanges() time.
+class LoadGenerator
+{
+public:
+  LoadGenerator( interactive_markers::InteractiveMarkerServer& server,
+                 std::vector<vm::InteractiveMarker>& markers,
+                 double rate, double report_interval ) :
+    server_( server ),
+    bytes_per_update_( 0 ),
+    report_interval_( report_interval ),
+    updates_( 0 ),
+    last_report_( ros::WallTime::now() )
+  {
+    // the markers can be large, take them over instead of copying
+    markers_.swap( markers );
+    for( unsigned i = 0; i < markers_.size(); i++ )
+    {
+      bytes_per_update_ += ros::serialization::serializationLength( markers_[i] );
+    }
+    ros::NodeHandle nh;
+    timer_ = nh.createWallTimer( ros::WallDuration( 1.0 / rate ), &LoadGenerator::update, this );
+  }
+
+  void update( const ros::WallTimerEvent& )
+  {
+    // re-inserting sends the whole marker again, keeping its callbacks
+    ros::Time now = ros::Time::now();
+    for( unsigned i = 0; i < markers_.size(); i++ )
+    {
+      markers_[i].header.stamp = now;
+      server_.insert( markers_[i] );
+    }
+
+    ros::WallTime start = ros::WallTime::now();
+    server_.applyChanges();
+    ros::WallTime end = ros::WallTime::now();
+    latencies_.push_back( ( end - start ).toSec() * 1e3 );
+    updates_++;
+
+    double elapsed = ( end - last_report_ ).toSec();
+    if( elapsed >= report_interval_ )
+    {
+      report( elapsed );
+      last_report_ = end;
+    }
+  }
+
+private:
+  double percentile( double p ) const
+  {
+    return latencies_[std::min( (size_t)( p * latencies_.size() ), latencies_.size() - 1 )];
+  }
+
+  void report( double elapsed )
+  {
+    std::sort( latencies_.begin(), latencies_.end() );
+    ROS_INFO( "%.1f msgs/s, %.0f markers/s, %.1f MB/s, applyChanges ms: p50 %.2f p90 %.2f p99 %.2f max %.2f",
+              updates_ / elapsed, updates_ * markers_.size() / elapsed,
+              updates_ * bytes_per_update_ / elapsed / 1e6,
+              percentile( 0.5 ), percentile( 0.9 ), percentile( 0.99 ), latencies_.back() );
+    latencies_.clear();
+    updates_ = 0;
+  }
+
+  interactive_markers::InteractiveMarkerServer& server_;
+  std::vector<vm::InteractiveMarker> markers_;
+  double bytes_per_update_;
+  double report_interval_;
+
+  ros::WallTimer timer_;
+  size_t updates_;
+  std::vector<double> latencies_;
+  ros::WallTime last_report_;
+};
+
+// The marker types of the tutorial, with their default sizes.  0 points
+// means the size given with --points.
+struct MarkerType
+{
+  const char* name;
+  const char* description;
+  int32_t type;
+  int num_points;
+  float scale;
+};
+
+const MarkerType marker_types[] =
+{
+  { "points", "Points marker", vm::Marker::POINTS, 0, 0.1f },
+  // LINE_STRIP and LINE_LIST are not actually selectable, and they won't highlight or detect mouse clicks like the others (yet).
+  { "line_strip", "Line Strip marker", vm::Marker::LINE_STRIP, 1000, 0.1f },
+  { "line_list", "Line List marker", vm::Marker::LINE_LIST, 0, 0.1f },
+  { "cube_list", "Cube List marker", vm::Marker::CUBE_LIST, 0, 0.1f },
+  { "sphere_list", "Sphere List marker", vm::Marker::SPHERE_LIST, 0, 0.1f },
+  { "triangle_list", "Triangle List marker", vm::Marker::TRIANGLE_LIST, 201, 1.0f },
+};
+
+const MarkerType* findMarkerType( const std::string& name )
+{
+  for( unsigned i = 0; i < sizeof( marker_types ) / sizeof( marker_types[0] ); i++ )
+  {
+    if( name == marker_types[i].name )
+    {
+      return &marker_types[i];
+    }
+  }
+  return 0;
+}
+
 int main(int argc, char** argv)
 {
   ros::init(argc, argv, "point_cloud");
 
+  // point_cloud [--points <count>] sets the points of the larger markers
+  int num_points = 10000;
+  for( int i = 1; i + 1 < argc; i++ )
+  {
+    if( std::string( argv[i] ) == "--points" )
+    {
+      num_points = std::max( atoi( argv[i + 1] ), 1 );
+    }
+  }
+
+  ros::WallTime start = ros::WallTime::now();
+
+  // The parameters turn the tutorial into a load generator:
+  //   ~marker_types       comma separated types of the markers, cycled
+  //                       through (default: all of them)
+  //   ~num_markers        number of markers (default: one per type)
+  //   ~points_per_marker  points of every marker (default: the tutorial
+  //                       sizes, with --points for the large ones),
+  //                       rounded down to whole lines and triangles
+  //   ~update_rate        markers are republished this often per second
+  //                       (default: 0, published once)
+  //   ~report_interval    seconds between throughput reports (default: 5)
+  //   ~palette            color the points by height, gray or rainbow
+  //                       (default: none, all gray)
+  // and to send the points in a compact encoding, on point_cloud/chunks
+  // for point_chunk_client, instead of through the server.  The points
+  // then can't be clicked and stay where they were sent:
+  //   ~encoding           float32 or int16 (default: none)
+  //   ~compress           LZ4 compress the chunks (default: false)
+  //   ~chunk_bytes        encoded points per chunk, before compression
+  //                       (default: 1 MB)
+  ros::NodeHandle private_nh( "~" );
+  std::string type_list, palette_name, encoding;
+  int num_markers, points_per_marker, chunk_bytes;
+  double update_rate, report_interval;
+  bool compress;
+  private_nh.param( "marker_types", type_list,
+                    std::string( "points,line_strip,line_list,cube_list,sphere_list,triangle_list" ) );
+  private_nh.param( "num_markers", num_markers, 0 );
+  private_nh.param( "points_per_marker", points_per_marker, 0 );
+  private_nh.param( "update_rate", update_rate, 0.0 );
+  private_nh.param( "report_interval", report_interval, 5.0 );
+  private_nh.param( "palette", palette_name, std::string() );
+  private_nh.param( "encoding", encoding, std::string() );
+  private_nh.param( "compress", compress, false );
+  private_nh.param( "chunk_bytes", chunk_bytes, 1 << 20 );
+
+  std::vector<const MarkerType*> types;
+  std::stringstream type_stream( type_list );
+  std::string type_name;
+  while( std::getline( type_stream, type_name, ',' ) )
+  {
+    const MarkerType* type = findMarkerType( type_name );
+    if( !type )
+    {
+      ROS_ERROR( "unknown marker type %s", type_name.c_str() );
+      return 1;
+    }
+    types.push_back( type );
+  }
+  if( types.empty() )
+  {
+    ROS_ERROR( "no marker types given" );
+    return 1;
+  }
+  if( num_markers <= 0 )
+  {
+    num_markers = types.size();
+  }
+
+  boost::scoped_ptr<ColorPalette> palette;
+  if( !palette_name.empty() )
+  {
+    std::vector<std_msgs::ColorRGBA> stops;
+    if( !ColorPalette::byName( palette_name, stops ) )
+    {
+      ROS_ERROR( "unknown palette %s", palette_name.c_str() );
+      return 1;
+    }
+    palette.reset( new ColorPalette( stops ) );
+  }
+
+  boost::scoped_ptr<ChunkPublisher> chunk_publisher;
+  if( encoding == "float32" || encoding == "int16" )
+  {
+    chunk_publisher.reset( new ChunkPublisher( encoding == "int16" ? PointChunk::INT16 : PointChunk::FLOAT32,
+                                               compress, std::max( chunk_bytes, 1 ), palette.get() ) );
+  }
+  else if( !encoding.empty() )
+  {
+    ROS_ERROR( "unknown encoding %s", encoding.c_str() );
+    return 1;
+  }
+
   // create an interactive marker server on the topic namespace simple_marker
   interactive_markers::InteractiveMarkerServer server("point_cloud");
 
-  server.insert(makeMarker("points", "Points marker", vm::Marker::POINTS, 0), &processFeedback);
-  // LINE_STRIP and LINE_LIST are not actually selectable, and they won't highlight or detect mouse clicks like the others (yet).
-  server.insert(makeMarker("line_strip", "Line Strip marker", vm::Marker::LINE_STRIP, 10, 1000), &processFeedback);
-  server.insert(makeMarker("line_list", "Line List marker", vm::Marker::LINE_LIST, 20), &processFeedback);
-  server.insert(makeMarker("cube_list", "Cube List marker", vm::Marker::CUBE_LIST, 30), &processFeedback);
-  server.insert(makeMarker("sphere_list", "Sphere List marker", vm::Marker::SPHERE_LIST, 40), &processFeedback);
-  server.insert(makeMarker("triangle_list", "Triangle List marker", vm::Marker::TRIANGLE_LIST, 50, 201, 1.0f), &processFeedback);
+  std::vector<vm::InteractiveMarker> markers;
+  for( int i = 0; i < num_markers; i++ )
+  {
+    const MarkerType& type = *types[i % types.size()];
+    std::string name = type.name;
+    if( i >= (int)types.size() )
+    {
+      std::stringstream ss;
+      ss << type.name << "_" << i;
+      name = ss.str();
+    }
+    int points = points_per_marker > 0 ? points_per_marker : ( type.num_points > 0 ? type.num_points : num_points );
+    int group = interactive_marker_tutorials::markerPointGroup( type.type );
+    if( points % group != 0 )
+    {
+      int rounded = std::max( points / group * group, group );
+      // once per type, not for every marker
+      if( i < (int)types.size() )
+      {
+        ROS_WARN( "%s markers take points in groups of %d, using %d points instead of %d",
+                  type.name, group, rounded, points );
+      }
+      points = rounded;
+    }
+    // the chunk publisher colors chunked points itself
+    markers.push_back( makeMarker( name, type.description, type.type, 10 * i, points, type.scale,
+                                   chunk_publisher ? 0 : palette.get() ) );
+    if( chunk_publisher )
+    {
+      chunk_publisher->takePoints( markers.back() );
+      server.insert( markers.back(), &processFeedback );
+    }
+    else
+    {
+      insertPickable( server, markers.back() );
+    }
+
+    // only the load generator sends the markers again, without it the
+    // server's copy is the only one kept
+    if( update_rate <= 0 )
+    {
+      markers.pop_back();
+    }
+  }
+
+  ROS_INFO( "made %d markers in %.1f ms", num_markers, ( ros::WallTime::now() - start ).toSec() * 1e3 );
 
   // 'commit' changes and send to all clients
   server.applyChanges();
+  if( chunk_publisher )
+  {
+    chunk_publisher->advertise();
+  }
+
+  boost::scoped_ptr<LoadGenerator> load;
+  if( update_rate > 0 )
+  {
+    load.reset( new LoadGenerator( server, markers, update_rate, report_interval ) );
+  }
 
   // start the ROS main loop
   ros::spin();
@@ -0,0 +1,283 @@
+/*
+ * Copyright (c) 2011, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+// Benchmarks of the point_cloud tutorial: sending the points of a large
+// marker as a plain Marker against the PointChunk encodings, reported in
+// bytes per point, the largest message and the time to encode and
+// serialize, or deserialize and decode, and coloring the points of a
+// marker from a scalar field.  Runs standalone, no ROS master needed:
+//
+//   rosrun interactive_marker_tutorials point_cloud_benchmark --benchmark_filter=/1000000/
+
+#include <math.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <ros/serialization.h>
+#include <tf/LinearMath/Vector3.h>
+#include <visualization_msgs/Marker.h>
+
+#include <interactive_marker_tutorials/PointChunk.h>
+#include <interactive_marker_tutorials/color_palette.h>
+#include <interactive_marker_tutorials/point_encoding.h>
+#include <interactive_marker_tutorials/surface_points.h>
+
+using interactive_marker_tutorials::ColorPalette;
+using interactive_marker_tutorials::PointChunk;
+
+namespace vm = visualization_msgs;
+
+namespace
+{
+
+// The transports compared, the second benchmark argument.  The third
+// one turns on LZ4 for the chunks.
+enum Transport
+{
+  PLAIN_MARKER,
+  FLOAT32_CHUNKS,
+  INT16_CHUNKS
+};
+
+const size_t chunk_bytes = 1 << 20;
+
+// A points marker of the surface of the selection tutorial, in the
+// random order of a scan rather than the smooth order of the helix,
+// which would flatter the compression.
+void makeMarker( vm::Marker& marker, int num_points )
+{
+  std::vector<tf::Vector3> points;
+  interactive_marker_tutorials::makePoints( points, num_points );
+
+  marker.type = vm::Marker::POINTS;
+  marker.points.resize( num_points );
+  for ( int i=0; i<num_points; i++ )
+  {
+    marker.points[i].x = points[i].x();
+    marker.points[i].y = points[i].y();
+    marker.points[i].z = points[i].z();
+  }
+}
+
+template<class Message>
+size_t serialize( const Message& msg, std::vector<uint8_t>& buffer )
+{
+  uint32_t size = ros::serialization::serializationLength( msg );
+  buffer.resize( size );
+  ros::serialization::OStream stream( buffer.data(), size );
+  ros::serialization::serialize( stream, msg );
+  return size;
+}
+
+template<class Message>
+void deserialize( std::vector<uint8_t>& buffer, Message& msg )
+{
+  ros::serialization::IStream stream( buffer.data(), buffer.size() );
+  ros::serialization::deserialize( stream, msg );
+}
+
+// Serialize a marker the way the transport sends it, one buffer per
+// message.
+void send( const vm::Marker& marker, int transport, bool compress,
+           std::vector<PointChunk>& chunks, std::vector<std::vector<uint8_t> >& buffers )
+{
+  if ( transport == PLAIN_MARKER )
+  {
+    buffers.resize( 1 );
+    serialize( marker, buffers[0] );
+    return;
+  }
+
+  uint8_t encoding = transport == INT16_CHUNKS ? PointChunk::INT16 : PointChunk::FLOAT32;
+  interactive_marker_tutorials::encodeMarker( marker, encoding, compress, chunk_bytes, chunks );
+  buffers.resize( chunks.size() );
+  for ( size_t i=0; i<chunks.size(); i++ )
+  {
+    serialize( chunks[i], buffers[i] );
+  }
+}
+
+void reportMessages( benchmark::State& state, const std::vector<std::vector<uint8_t> >& buffers, size_t num_points )
+{
+  size_t bytes = 0, largest = 0;
+  for ( size_t i=0; i<buffers.size(); i++ )
+  {
+    bytes += buffers[i].size();
+    largest = std::max( largest, buffers[i].size() );
+  }
+  state.counters["bytes/point"] = (double)bytes / num_points;
+  state.counters["messages"] = buffers.size();
+  state.counters["largest_kb"] = largest / 1024.0;
+  state.SetItemsProcessed( state.iterations() * num_points );
+}
+
+void BM_EncodeMarker( benchmark::State& state )
+{
+  vm::Marker marker;
+  makeMarker( marker, state.range( 0 ) );
+  std::vector<PointChunk> chunks;
+  std::vector<std::vector<uint8_t> > buffers;
+
+  for ( auto _ : state )
+  {
+    send( marker, state.range( 1 ), state.range( 2 ), chunks, buffers );
+    benchmark::DoNotOptimize( buffers.data() );
+  }
+  reportMessages( state, buffers, marker.points.size() );
+
+  // how far the decoded points are off
+  double error = 0;
+  vm::Marker decoded;
+  for ( size_t c=0; c<chunks.size(); c++ )
+  {
+    interactive_marker_tutorials::decodeMarker( chunks[c], decoded );
+    for ( size_t i=0; i<decoded.points.size(); i++ )
+    {
+      const geometry_msgs::Point& p = marker.points[chunks[c].first_point + i];
+      error = std::max( error, fabs( decoded.points[i].x - p.x ) );
+      error = std::max( error, fabs( decoded.points[i].y - p.y ) );
+      error = std::max( error, fabs( decoded.points[i].z - p.z ) );
+    }
+  }
+  state.counters["max_error_mm"] = error * 1e3;
+}
+
+void BM_DecodeMarker( benchmark::State& state )
+{
+  vm::Marker marker;
+  makeMarker( marker, state.range( 0 ) );
+  std::vector<PointChunk> chunks;
+  std::vector<std::vector<uint8_t> > buffers;
+  send( marker, state.range( 1 ), state.range( 2 ), chunks, buffers );
+
+  vm::Marker decoded;
+  PointChunk chunk;
+  for ( auto _ : state )
+  {
+    for ( size_t i=0; i<buffers.size(); i++ )
+    {
+      if ( state.range( 1 ) == PLAIN_MARKER )
+      {
+        deserialize( buffers[i], decoded );
+      }
+      else
+      {
+        deserialize( buffers[i], chunk );
+        interactive_marker_tutorials::decodeMarker( chunk, decoded );
+      }
+      benchmark::DoNotOptimize( decoded.points.data() );
+    }
+  }
+  reportMessages( state, buffers, marker.points.size() );
+}
+
+void transportArgs( benchmark::internal::Benchmark* b )
+{
+  const int sizes[] = { 100000, 1000000 };
+  for ( int i=0; i<2; i++ )
+  {
+    b->Args( { sizes[i], PLAIN_MARKER, 0 } );
+    for ( int transport=FLOAT32_CHUNKS; transport<=INT16_CHUNKS; transport++ )
+    {
+      b->Args( { sizes[i], transport, 0 } );
+      b->Args( { sizes[i], transport, 1 } );
+    }
+  }
+}
+
+// An intensity per point, as a scanner reports it.
+void makeIntensities( std::vector<float>& intensities, int num_points )
+{
+  intensities.resize( num_points );
+  for ( int i=0; i<num_points; i++ )
+  {
+    intensities[i] = interactive_marker_tutorials::uniformRandom( 0.0, 4096.0 );
+  }
+}
+
+// Colors built point by point, interpolating the palette stops for
+// every point and appending to a fresh vector, as a straightforward
+// port of the single marker color would.
+void BM_ColorPerPoint( benchmark::State& state )
+{
+  std::vector<float> intensities;
+  makeIntensities( intensities, state.range( 0 ) );
+  std::vector<std_msgs::ColorRGBA> stops;
+  ColorPalette::byName( "rainbow", stops );
+
+  for ( auto _ : state )
+  {
+    vm::Marker marker;
+    for ( size_t i=0; i<intensities.size(); i++ )
+    {
+      float t = std::min( std::max( intensities[i] / 4096.0f, 0.0f ), 1.0f ) * ( stops.size() - 1 );
+      size_t k = std::min( (size_t)t, stops.size() - 2 );
+      float f = t - k;
+      std_msgs::ColorRGBA color;
+      color.r = stops[k].r + f * ( stops[k + 1].r - stops[k].r );
+      color.g = stops[k].g + f * ( stops[k + 1].g - stops[k].g );
+      color.b = stops[k].b + f * ( stops[k + 1].b - stops[k].b );
+      color.a = 1.0f;
+      marker.colors.push_back( color );
+    }
+    benchmark::DoNotOptimize( marker.colors.data() );
+  }
+  state.SetItemsProcessed( state.iterations() * intensities.size() );
+}
+
+// Colors through ColorPalette, into the colors of a marker kept between
+// updates.
+void BM_ColorPalette( benchmark::State& state )
+{
+  std::vector<float> intensities;
+  makeIntensities( intensities, state.range( 0 ) );
+  std::vector<std_msgs::ColorRGBA> stops;
+  ColorPalette::byName( "rainbow", stops );
+  ColorPalette palette( stops );
+
+  vm::Marker marker;
+  for ( auto _ : state )
+  {
+    palette.map( [&intensities]( size_t i ) { return intensities[i]; }, intensities.size(),
+                 0.0f, 4096.0f, marker.colors );
+    benchmark::DoNotOptimize( marker.colors.data() );
+  }
+  state.SetItemsProcessed( state.iterations() * intensities.size() );
+}
+
+} // namespace
+
+BENCHMARK( BM_ColorPerPoint )->Arg( 1000000 )->Unit( benchmark::kMillisecond );
+BENCHMARK( BM_ColorPalette )->Arg( 1000000 )->Unit( benchmark::kMillisecond );
+BENCHMARK( BM_EncodeMarker )->Apply( transportArgs )->Unit( benchmark::kMillisecond );
+BENCHMARK( BM_DecodeMarker )->Apply( transportArgs )->Unit( benchmark::kMillisecond );
+
+BENCHMARK_MAIN();
@@ -38,28 +38,328 @@
 #include <tf/LinearMath/Vector3.h>
 #include <tf/tf.h>
 
-bool testPointAgainstAabb2(const tf::Vector3 &aabbMin1, const tf::Vector3 &aabbMax1,
-                           const tf::Vector3 &point)
-{
-	bool overlap = true;
-	overlap = (aabbMin1.getX() > point.getX() || aabbMax1.getX() < point.getX()) ? false : overlap;
-	overlap = (aabbMin1.getZ() > point.getZ() || aabbMax1.getZ() < point.getZ()) ? false : overlap;
-	overlap = (aabbMin1.getY() > point.getY() || aabbMax1.getY() < point.getY()) ? false : overlap;
-	return overlap;
-}
+#include <sensor_msgs/PointCloud2.h>
+
+#include <interactive_marker_tutorials/GetSelection.h>
+#include <interactive_marker_tutorials/SelectionDelta.h>
+#include <interactive_marker_tutorials/SetSelectionBox.h>
+
+#include <interactive_marker_tutorials/marker_points.h>
+#include <interactive_marker_tutorials/parallel_classify.h>
+#include <interactive_marker_tutorials/point_cloud2_view.h>
+#include <interactive_marker_tutorials/point_decimation.h>
+#include <interactive_marker_tutorials/point_file.h>
+#include <interactive_marker_tutorials/point_kd_tree.h>
+#include <interactive_marker_tutorials/point_store.h>
+#include <interactive_marker_tutorials/quantized_point_store.h>
+#include <interactive_marker_tutorials/selection_file.h>
+#include <interactive_marker_tutorials/selection_mask.h>
+#include <interactive_marker_tutorials/selection_set.h>
+#include <interactive_marker_tutorials/selection_volume.h>
+#include <interactive_marker_tutorials/surface_points.h>
+#include <interactive_marker_tutorials/worker_pool.h>
+
+using interactive_marker_tutorials::Aabb;
+using interactive_marker_tutorials::MappedPointFile;
+using interactive_marker_tutorials::OrientedBox;
+using interactive_marker_tutorials::PointCloud2View;
+using interactive_marker_tutorials::PointKdTree;
+using interactive_marker_tutorials::PointStore;
+using interactive_marker_tutorials::PolygonPrism;
+using interactive_marker_tutorials::QuantizedPointStore;
+using interactive_marker_tutorials::SelectionSet;
+using interactive_marker_tutorials::WorkerPool;
+using interactive_marker_tutorials::makePoints;
 
 namespace vm = visualization_msgs;
 
+// Publishes the points once and from then on only the changes of the
+// selection, see SelectionDelta.msg.  selection_client is the matching
+// consumer.
+class SelectionMaskPublisher
+{
+public:
+  template<class Points>
+  SelectionMaskPublisher( ros::NodeHandle nh, const Points& points, int keyframe_interval ) :
+    num_points_( points.size() ),
+    published_( ( points.size() + 63 ) / 64, 0 ),
+    sequence_( 0 ),
+    keyframe_interval_( keyframe_interval )
+  {
+    points_pub_ = nh.advertise<sensor_msgs::PointCloud2>( "points", 1, true );
+    delta_pub_ = nh.advertise<interactive_marker_tutorials::SelectionDelta>(
+        "delta", 100, boost::bind( &SelectionMaskPublisher::connect, this, _1 ) );
+
+    sensor_msgs::PointCloud2 cloud;
+    makeCloud( points, cloud );
+    points_pub_.publish( cloud );
+  }
+
+  // Publish the points that changed state since the last call.
+  void publish( const std::vector<uint64_t>& mask )
+  {
+    boost::mutex::scoped_lock lock( mutex_ );
+
+    interactive_marker_tutorials::SelectionDelta msg;
+    interactive_marker_tutorials::maskDelta( published_, mask, msg.toggled );
+    if ( msg.toggled.empty() )
+    {
+      return;
+    }
+    published_ = mask;
+    sequence_++;
+
+    if ( keyframe_interval_ > 0 && sequence_ % keyframe_interval_ == 0 )
+    {
+      makeKeyframe( msg );
+    }
+    else
+    {
+      msg.header.frame_id = "base_link";
+      msg.header.stamp = ros::Time::now();
+      msg.sequence = sequence_;
+      msg.num_points = num_points_;
+    }
+    delta_pub_.publish( msg );
+  }
+
+private:
+  template<class Points>
+  static void makeCloud( const Points& points, sensor_msgs::PointCloud2& cloud )
+  {
+    const char* names[] = { "x", "y", "z" };
+
+    cloud.header.frame_id = "base_link";
+    cloud.header.stamp = ros::Time::now();
+    cloud.height = 1;
+    cloud.width = points.size();
+    cloud.fields.resize( 3 );
+    for ( int i=0; i<3; i++ )
+    {
+      cloud.fields[i].name = names[i];
+      cloud.fields[i].offset = 4 * i;
+      cloud.fields[i].datatype = sensor_msgs::PointField::FLOAT32;
+      cloud.fields[i].count = 1;
+    }
+    cloud.is_bigendian = false;
+    cloud.point_step = 12;
+    cloud.row_step = cloud.point_step * cloud.width;
+    cloud.is_dense = true;
+
+    cloud.data.resize( cloud.row_step );
+    float* data = reinterpret_cast<float*>( cloud.data.data() );
+    for ( size_t i=0; i<points.size(); i++ )
+    {
+      data[3 * i] = points.x( i );
+      data[3 * i + 1] = points.y( i );
+      data[3 * i + 2] = points.z( i );
+    }
+  }
+
+  void makeKeyframe( interactive_marker_tutorials::SelectionDelta& msg )
+  {
+    msg.header.frame_id = "base_link";
+    msg.header.stamp = ros::Time::now();
+    msg.sequence = sequence_;
+    msg.num_points = num_points_;
+    msg.toggled.clear();
+    interactive_marker_tutorials::packMask( published_, num_points_, msg.mask );
+  }
+
+  // New subscribers get the current state before any further delta.
+  void connect( const ros::SingleSubscriberPublisher& pub )
+  {
+    boost::mutex::scoped_lock lock( mutex_ );
+    interactive_marker_tutorials::SelectionDelta msg;
+    makeKeyframe( msg );
+    pub.publish( msg );
+  }
+
+  ros::Publisher points_pub_;
+  ros::Publisher delta_pub_;
+
+  // publish() runs in the feedback callback, connect() in a ROS thread
+  boost::mutex mutex_;
+  size_t num_points_;
+  std::vector<uint64_t> published_;
+  uint32_t sequence_;
+  int keyframe_interval_;
+};
+
+// Runs an update at most rate times per second, however often it is
+// requested.  Requests between two runs are merged into the next one,
+// which then sees only the latest state.  A rate of 0 runs every
+// request right away.
+class UpdateCoalescer
+{
+public:
+  UpdateCoalescer( const ros::NodeHandle& nh, double rate, const boost::function<void()>& update ) :
+    update_( update ),
+    pending_( false ),
+    requested_( 0 ),
+    runs_( 0 )
+  {
+    if ( rate > 0 )
+    {
+      timer_ = nh.createWallTimer( ros::WallDuration( 1.0 / rate ), &UpdateCoalescer::tick, this );
+    }
+    immediate_ = rate <= 0;
+  }
+
+  void request()
+  {
+    requested_++;
+    pending_ = true;
+    if ( immediate_ )
+    {
+      flush();
+    }
+  }
+
+  // Drop a pending update, e.g. because the caller publishes the final
+  // state itself.  It counts as merged.
+  void cancel()
+  {
+    pending_ = false;
+  }
+
+  void flush()
+  {
+    if ( pending_ )
+    {
+      pending_ = false;
+      runs_++;
+      update_();
+    }
+  }
+
+  // Number of requests that were absorbed by a later one.
+  uint64_t merged() const { return requested_ - runs_; }
+  uint64_t requested() const { return requested_; }
+
+private:
+  void tick( const ros::WallTimerEvent& )
+  {
+    flush();
+  }
+
+  boost::function<void()> update_;
+  ros::WallTimer timer_;
+  bool immediate_;
+  bool pending_;
+  uint64_t requested_;
+  uint64_t runs_;
+};
+
+struct SelectorOptions
+{
+  SelectorOptions() :
+    live_preview( false ),
+    num_threads( 0 ),
+    mask_deltas( false ),
+    keyframe_interval( 100 ),
+    max_marker_points( 100000 ),
+    update_rate( 30.0 ),
+    index_min_points( 1000000 ),
+    out_of_core( false )
+  {
+  }
+
+  // update the selection while dragging, not only on release
+  bool live_preview;
+
+  // threads used to classify the points, 0 for one per core
+  unsigned num_threads;
+
+  // publish selection changes as SelectionDelta messages instead of
+  // re-inserting the point cloud markers
+  bool mask_deltas;
+  int keyframe_interval;
+
+  // most points shown per point cloud marker, larger selections are
+  // thinned out for display (the selection itself is unaffected);
+  // 0 shows all points
+  int max_marker_points;
+
+  // most box and handle updates published per second while dragging,
+  // 0 publishes one per feedback message
+  double update_rate;
+
+  // clouds of at least this many points are indexed up front, so that
+  // releasing a handle classifies the box through the k-d tree instead
+  // of scanning every point; 0 only indexes for live preview and for
+  // volumes other than boxes
+  int index_min_points;
+
+  // the points are mapped from a file and may not fit in memory, so
+  // nothing but the selection masks grows with the point count: the
+  // point markers are sampled straight from the mask, no k-d tree is
+  // built and mask deltas are not supported
+  bool out_of_core;
+};
+
+// Points can be any point source that classifyParallel() accepts, like
+// PointStore, QuantizedPointStore or MappedPointFile.  The points are
+// shared, not copied.
+//
+// Besides the box dragged with the handles, more boxes, oriented boxes
+// and polygon prisms can be combined into the selection through the
+// selection/set_box service, and selection/get returns the indices of
+// the selected points.
+template<class Points>
 class PointCouldSelector
 {
 public:
 	PointCouldSelector( boost::shared_ptr<interactive_markers::InteractiveMarkerServer> server,
-	    std::vector<tf::Vector3>& points ) :
+	    boost::shared_ptr<const Points> points, const SelectorOptions& options = SelectorOptions() ) :
 	      server_( server ),
         min_sel_( -1, -1, -1 ),
         max_sel_( 1, 1, 1 ),
-        points_( points )
+        points_( points ),
+        out_of_core_( options.out_of_core ),
+        index_points_( !out_of_core_ &&
+                       ( options.live_preview ||
+                         ( options.index_min_points > 0 && points->size() >= (size_t)options.index_min_points ) ) ),
+        live_preview_( options.live_preview ),
+        max_marker_points_( std::max( options.max_marker_points, 0 ) ),
+        pool_( options.num_threads ),
+        box_updates_( ros::NodeHandle(), options.update_rate,
+                      boost::bind( &PointCouldSelector::publishBoxUpdate, this ) )
 	{
+	  ROS_INFO( "using %s box classification on %u threads",
+	            interactive_marker_tutorials::aabbKernelName( interactive_marker_tutorials::bestAabbKernel() ),
+	            pool_.size() );
+
+	  // index the points once, so box queries while dragging and on
+	  // release don't have to visit all of them
+	  if ( index_points_ )
+	  {
+	    tree_.build( *points_ );
+	  }
+
+    std_msgs::ColorRGBA in_color;
+    in_color.r = 1.0;
+    in_color.g = 0.8;
+    in_color.b = 0.0;
+    in_color.a = 1.0;
+
+    std_msgs::ColorRGBA out_color;
+    out_color.r = 0.5;
+    out_color.g = 0.5;
+    out_color.b = 0.5;
+    out_color.a = 1.0;
+
+    makePointCloud( sel_points_marker_, "selected_points", in_color );
+    makePointCloud( unsel_points_marker_, "unselected_points", out_color );
+
+    ros::NodeHandle nh( "selection" );
+    if ( options.mask_deltas && !out_of_core_ )
+    {
+      mask_publisher_.reset( new SelectionMaskPublisher( nh, *points_, options.keyframe_interval ) );
+    }
+    set_box_service_ = nh.advertiseService( "set_box", &PointCouldSelector::setBox, this );
+    get_service_ = nh.advertiseService( "get", &PointCouldSelector::getSelection, this );
+
 	  updateBox( );
 	  updatePointClouds();
 
@@ -80,15 +380,37 @@ public:
     if ( feedback->marker_name == "min_z" ) min_sel_.setZ( feedback->pose.position.z );
     if ( feedback->marker_name == "max_z" ) max_sel_.setZ( feedback->pose.position.z );
 
-    updateBox( );
-    updateSizeHandles();
-
+    // while dragging, RViz can send feedback faster than we publish, so
+    // only the latest box is published at the update rate
     if ( feedback->event_type == visualization_msgs::InteractiveMarkerFeedback::MOUSE_UP )
     {
+      box_updates_.cancel();
+      updateBox( );
+      updateSizeHandles();
       updatePointClouds();
+      server_->applyChanges();
+
+      ROS_INFO( "%lu of %lu box updates merged into later ones",
+                (unsigned long)box_updates_.merged(), (unsigned long)box_updates_.requested() );
+    }
+    else
+    {
+      box_updates_.request();
     }
+	}
+
+	void publishBoxUpdate()
+	{
+	  updateBox( );
+	  updateSizeHandles();
 
-    server_->applyChanges();
+	  if ( live_preview_ )
+	  {
+	    updateSelection( selectionBox() );
+	    publishPointClouds();
+	  }
+
+	  server_->applyChanges();
 	}
 
 	vm::Marker makeBox( vm::InteractiveMarker &msg,
@@ -124,10 +446,9 @@ public:
 	  server_->insert( msg );
 	}
 
-	void updatePointCloud( std::string name, std_msgs::ColorRGBA color, std::vector<tf::Vector3> &points )
+	void makePointCloud( vm::InteractiveMarker &int_marker, std::string name, std_msgs::ColorRGBA color )
 	{
 	  // create an interactive marker for our server
-	  vm::InteractiveMarker int_marker;
 	  int_marker.header.frame_id = "base_link";
 	  int_marker.name = name;
 
@@ -139,15 +460,6 @@ public:
 	  points_marker.scale.z = 0.05;
 	  points_marker.color = color;
 
-	  for ( unsigned i=0; i<points.size(); i++ )
-	  {
-	    geometry_msgs::Point p;
-      p.x = points[i].x();
-      p.y = points[i].y();
-      p.z = points[i].z();
-	    points_marker.points.push_back( p );
-	  }
-
 	  // create container control
 	  vm::InteractiveMarkerControl points_control;
 	  points_control.always_visible = true;
@@ -156,43 +468,271 @@ public:
 
 	  // add the control to the interactive marker
 	  int_marker.controls.push_back( points_control );
+	}
+
+	// The point cloud markers are kept between updates and their points
+	// are overwritten in place, so their buffers are only reallocated
+	// when a cloud grows beyond its largest size so far.
+	//
+	// Clouds larger than max_marker_points_ are decimated on a voxel grid
+	// first, with the spheres grown to the cell size to cover the gaps.
+	void updatePointCloud( vm::InteractiveMarker &int_marker, const std::vector<uint32_t> &indices )
+	{
+	  interactive_marker_tutorials::updatePointMarker( pool_, *points_, indices, max_marker_points_,
+	                                                   decimated_, int_marker.controls[0].markers[0] );
+	  server_->insert( int_marker );
+	}
 
+	// The same for out of core points, sampled from the selection mask
+	// without the index list of all selected or unselected points.
+	void updateSampledPointCloud( vm::InteractiveMarker &int_marker, bool selected )
+	{
+	  interactive_marker_tutorials::sampleMask( selected_, points_->size(), selected, max_marker_points_, decimated_ );
+	  // RViz rejects a marker with NaN points
+	  const Points& points = *points_;
+	  decimated_.erase( std::remove_if( decimated_.begin(), decimated_.end(), [&points]( uint32_t p )
+	                    { return !interactive_marker_tutorials::isFinitePoint( points, p ); } ),
+	                    decimated_.end() );
+	  interactive_marker_tutorials::fillMarkerPoints( pool_, *points_, decimated_,
+	                                                  int_marker.controls[0].markers[0].points );
 	  server_->insert( int_marker );
 	}
 
+	// Add, change or remove one of the boxes combined into the selection.
+	// Only that box is reclassified, the other ones keep their masks.
+	bool setBox( interactive_marker_tutorials::SetSelectionBox::Request& req,
+	             interactive_marker_tutorials::SetSelectionBox::Response& res )
+	{
+	  typedef interactive_marker_tutorials::SetSelectionBox::Request Request;
+
+	  if ( req.name.empty() || req.name == "box" )
+	  {
+	    res.success = false;
+	    res.message = "'" + req.name + "' can't be set, it is moved with the handles";
+	    return true;
+	  }
+
+	  std::string marker_name = "box_" + req.name;
+	  if ( req.operation == Request::REMOVE )
+	  {
+	    if ( !selection_set_.removeBox( req.name ) )
+	    {
+	      res.success = false;
+	      res.message = "no box named '" + req.name + "'";
+	      return true;
+	    }
+	    server_->erase( marker_name );
+	  }
+	  else if ( req.operation <= Request::DIFFERENCE && req.shape <= Request::POLYGON_PRISM )
+	  {
+	    SelectionSet::Operation operation = SelectionSet::Operation( req.operation );
+	    vm::InteractiveMarker msg;
+	    msg.header.frame_id = "base_link";
+	    msg.name = marker_name;
+	    vm::Marker marker;
+
+	    if ( req.shape == Request::BOX )
+	    {
+	      tf::Vector3 min_bound( std::min( req.min.x, req.max.x ), std::min( req.min.y, req.max.y ),
+	                             std::min( req.min.z, req.max.z ) );
+	      tf::Vector3 max_bound( std::max( req.min.x, req.max.x ), std::max( req.min.y, req.max.y ),
+	                             std::max( req.min.z, req.max.z ) );
+	      selection_set_.setBox( req.name,
+	                             Aabb( min_bound.x(), min_bound.y(), min_bound.z(),
+	                                   max_bound.x(), max_bound.y(), max_bound.z() ),
+	                             operation );
+	      marker = makeBox( msg, min_bound, max_bound );
+	    }
+	    else if ( req.shape == Request::ORIENTED_BOX )
+	    {
+	      const geometry_msgs::Pose& pose = req.pose;
+	      selection_set_.setOrientedBox( req.name,
+	                                     OrientedBox( pose.position.x, pose.position.y, pose.position.z,
+	                                                  req.size.x, req.size.y, req.size.z,
+	                                                  pose.orientation.x, pose.orientation.y,
+	                                                  pose.orientation.z, pose.orientation.w ),
+	                                     operation );
+	      marker.type = vm::Marker::CUBE;
+	      marker.pose = pose;
+	      marker.scale = req.size;
+	    }
+	    else
+	    {
+	      if ( req.polygon.size() < 3 )
+	      {
+	        res.success = false;
+	        res.message = "a polygon needs at least three corners";
+	        return true;
+	      }
+	      PolygonPrism prism;
+	      prism.min_z = std::min( req.min.z, req.max.z );
+	      prism.max_z = std::max( req.min.z, req.max.z );
+	      for ( unsigned i=0; i<req.polygon.size(); i++ )
+	      {
+	        prism.addVertex( req.polygon[i].x, req.polygon[i].y );
+	      }
+	      selection_set_.setPolygonPrism( req.name, prism, operation );
+	      marker = makePrismOutline( prism );
+	    }
+
+	    // the tree lets oriented boxes and prisms skip most of the points
+	    if ( req.shape != Request::BOX && !index_points_ && !out_of_core_ )
+	    {
+	      index_points_ = true;
+	      tree_.build( *points_ );
+	    }
+
+	    // show the volume, green for union, blue for intersection and red
+	    // for difference
+	    marker.color.r = req.operation == Request::DIFFERENCE ? 0.8 : 0.2;
+	    marker.color.g = req.operation == Request::UNION ? 0.8 : 0.2;
+	    marker.color.b = req.operation == Request::INTERSECTION ? 0.8 : 0.2;
+	    marker.color.a = req.shape == Request::POLYGON_PRISM ? 1.0 : 0.3;
+
+	    vm::InteractiveMarkerControl control;
+	    control.always_visible = true;
+	    control.interaction_mode = vm::InteractiveMarkerControl::NONE;
+	    control.markers.push_back( marker );
+	    msg.controls.push_back( control );
+	    server_->insert( msg );
+	  }
+	  else
+	  {
+	    res.success = false;
+	    res.message = "unknown operation or shape";
+	    return true;
+	  }
+
+	  updatePointClouds();
+	  server_->applyChanges();
+	  res.success = true;
+	  return true;
+	}
+
+	// Return the indices of the selected points, taken from the mask of
+	// the last classification.  Nothing is classified again and no
+	// coordinates are copied.
+	bool getSelection( interactive_marker_tutorials::GetSelection::Request& req,
+	                   interactive_marker_tutorials::GetSelection::Response& res )
+	{
+	  interactive_marker_tutorials::maskIndices( selected_, res.indices );
+	  res.num_points = points_->size();
+	  res.success = true;
+
+	  if ( !req.filename.empty() &&
+	       !interactive_marker_tutorials::writeSelectionFile( req.filename, points_->size(), res.indices ) )
+	  {
+	    res.success = false;
+	    res.message = "can't write " + req.filename + ": " + strerror( errno );
+	  }
+	  return true;
+	}
+
+	// The edges of a polygon prism as a line list.
+	vm::Marker makePrismOutline( const PolygonPrism& prism )
+	{
+	  vm::Marker marker;
+	  marker.type = vm::Marker::LINE_LIST;
+	  marker.scale.x = 0.02;
+
+	  geometry_msgs::Point a, b;
+	  for ( size_t i=0, j=prism.xs.size()-1; i<prism.xs.size(); j=i++ )
+	  {
+	    a.x = prism.xs[j]; a.y = prism.ys[j];
+	    b.x = prism.xs[i]; b.y = prism.ys[i];
+	    a.z = b.z = prism.min_z;
+	    marker.points.push_back( a );
+	    marker.points.push_back( b );
+	    a.z = b.z = prism.max_z;
+	    marker.points.push_back( a );
+	    marker.points.push_back( b );
+	    b = a;
+	    b.z = prism.min_z;
+	    marker.points.push_back( a );
+	    marker.points.push_back( b );
+	  }
+	  return marker;
+	}
+
+	Aabb selectionBox() const
+	{
+	  return Aabb( min_sel_.x(), min_sel_.y(), min_sel_.z(),
+	               max_sel_.x(), max_sel_.y(), max_sel_.z() );
+	}
+
+	// Select from new points, e.g. the latest scan of a sensor.  The index
+	// is rebuilt (reusing its memory) only if it is in use, and all
+	// volumes are classified again.
+	void setPoints( boost::shared_ptr<const Points> points )
+	{
+	  points_ = points;
+	  if ( index_points_ )
+	  {
+	    tree_.build( *points_ );
+	  }
+	  selection_set_.invalidate();
+
+	  updatePointClouds();
+	  server_->applyChanges();
+	}
+
 	void updatePointClouds()
 	{
-	  std::vector<tf::Vector3> points_in, points_out;
-    points_in.reserve( points_.size() );
-    points_out.reserve( points_.size() );
+    // determine which points are selected (i.e. inside the selection
+    // boxes); only boxes that changed are classified again, so the
+    // handle box is only set when the handles moved
+    Aabb box = selectionBox();
+    if ( box != handle_box_ || !selection_set_.hasBox( "box" ) )
+    {
+      selection_set_.setBox( "box", box );
+      handle_box_ = box;
+    }
+    selection_set_.update( pool_, *points_, selected_, index_points_ ? &tree_ : 0 );
 
-    // determine which points are selected (i.e. inside the selection box)
-	  for ( unsigned i=0; i<points_.size(); i++ )
+    publishPointClouds();
+	}
+
+	// Update the selection after the box was moved to new_box.  Only
+	// points in the region swept by the moving face can change state, so
+	// the cost of classifying depends on how far the face moved, not on
+	// the cloud size.
+	void updateSelection( const Aabb& new_box )
+	{
+	  if ( new_box != handle_box_ )
 	  {
-	    if ( testPointAgainstAabb2( min_sel_, max_sel_, points_[i] ) )
+	    if ( index_points_ )
 	    {
-	      points_in.push_back( points_[i] );
+	      selection_set_.moveBox( "box", new_box, *points_, tree_ );
 	    }
 	    else
 	    {
-        points_out.push_back( points_[i] );
+	      // out of core, without a tree every update is a pass over the file
+	      selection_set_.setBox( "box", new_box );
 	    }
+	    handle_box_ = new_box;
 	  }
+	  selection_set_.update( pool_, *points_, selected_, index_points_ ? &tree_ : 0 );
+	}
 
-    std_msgs::ColorRGBA in_color;
-    in_color.r = 1.0;
-    in_color.g = 0.8;
-    in_color.b = 0.0;
-    in_color.a = 1.0;
+	void publishPointClouds()
+	{
+	  if ( mask_publisher_ )
+	  {
+	    mask_publisher_->publish( selected_ );
+	    return;
+	  }
 
-    std_msgs::ColorRGBA out_color;
-    out_color.r = 0.5;
-    out_color.g = 0.5;
-    out_color.b = 0.5;
-    out_color.a = 1.0;
+	  if ( out_of_core_ )
+	  {
+	    updateSampledPointCloud( sel_points_marker_, true );
+	    updateSampledPointCloud( unsel_points_marker_, false );
+	    return;
+	  }
+
+	  interactive_marker_tutorials::splitByMask( pool_, selected_, points_->size(), points_in_, points_out_ );
 
-    updatePointCloud( "selected_points", in_color, points_in );
-    updatePointCloud( "unselected_points", out_color, points_out );
+    updatePointCloud( sel_points_marker_, points_in_ );
+    updatePointCloud( unsel_points_marker_, points_out_ );
 	}
 
   void makeSizeHandles( )
@@ -291,33 +831,103 @@ private:
 	boost::shared_ptr<interactive_markers::InteractiveMarkerServer> server_;
 
 	tf::Vector3 min_sel_, max_sel_;
-	std::vector<tf::Vector3> points_;
+	boost::shared_ptr<const Points> points_;
+	bool out_of_core_;
+	PointKdTree tree_;
+	// tree_ is kept up to date, for large clouds, live preview and non-box
+	// volumes
+	bool index_points_;
+
+	// the handle box and the boxes added through set_box, and the handle
+	// box as last set in selection_set_
+	SelectionSet selection_set_;
+	Aabb handle_box_;
+
+	// one bit per point, set if it is selected
+	std::vector<uint64_t> selected_;
+	std::vector<uint32_t> points_in_, points_out_;
+
+	// update the selection while dragging, not only on release
+	bool live_preview_;
+
+	size_t max_marker_points_;
+	std::vector<uint32_t> decimated_;
+
+	// threads used to classify the points
+	WorkerPool pool_;
 
 	vm::InteractiveMarker sel_points_marker_;
 	vm::InteractiveMarker unsel_points_marker_;
+
+	boost::scoped_ptr<SelectionMaskPublisher> mask_publisher_;
+	ros::ServiceServer set_box_service_;
+	ros::ServiceServer get_service_;
+
+	UpdateCoalescer box_updates_;
 };
 
 
 
 
-double rand( double min, double max )
+template<class Points>
+void run( boost::shared_ptr<interactive_markers::InteractiveMarkerServer> server,
+          boost::shared_ptr<const Points> points, const SelectorOptions& options )
 {
-  double t = (double)rand() / (double)RAND_MAX;
-  return min + t*(max-min);
+  PointCouldSelector<Points> selector( server, points, options );
+
+  // 'commit' changes and send to all clients
+  server->applyChanges();
+
+  // start the ROS main loop
+  ros::spin();
 }
 
 
-void makePoints( std::vector<tf::Vector3>& points_out, int num_points )
+// Feeds the scans of a PointCloud2 topic to a selector, so that the
+// selection follows a live sensor.  The scans are read in place, and
+// with a queue of one a slow update skips to the latest scan instead
+// of falling behind.
+class PointCloudStream
 {
-  double radius = 3;
-  double scale = 0.2;
-  points_out.resize(num_points);
-  for( int i = 0; i < num_points; i++ )
+public:
+  PointCloudStream( PointCouldSelector<PointCloud2View>& selector, const std::string& topic ) :
+    selector_( selector )
+  {
+    ros::NodeHandle nh;
+    sub_ = nh.subscribe( topic, 1, &PointCloudStream::processCloud, this );
+  }
+
+  void processCloud( const sensor_msgs::PointCloud2ConstPtr& msg )
   {
-    points_out[i].setX( scale * rand( -radius, radius ) );
-	  points_out[i].setY( scale * rand( -radius, radius ) );
-    points_out[i].setZ( scale * radius * 0.2 * ( sin( 10.0 / radius * points_out[i].x() ) + cos( 10.0 / radius * points_out[i].y() ) ) );
+    boost::shared_ptr<PointCloud2View> points( new PointCloud2View );
+    if ( !points->assign( msg ) )
+    {
+      ROS_WARN_THROTTLE( 5.0, "ignoring point cloud without float32 x, y and z fields" );
+      return;
+    }
+    if ( msg->header.frame_id != "base_link" )
+    {
+      ROS_WARN_ONCE( "point cloud is in frame %s, selecting as if it were in base_link",
+                     msg->header.frame_id.c_str() );
+    }
+    selector_.setPoints( points );
   }
+
+private:
+  PointCouldSelector<PointCloud2View>& selector_;
+  ros::Subscriber sub_;
+};
+
+void runStream( boost::shared_ptr<interactive_markers::InteractiveMarkerServer> server,
+                const std::string& topic, const SelectorOptions& options )
+{
+  // start out empty until the first scan arrives
+  boost::shared_ptr<const PointCloud2View> points( new PointCloud2View );
+  PointCouldSelector<PointCloud2View> selector( server, points, options );
+  PointCloudStream stream( selector, topic );
+
+  server->applyChanges();
+  ros::spin();
 }
 
 
@@ -329,15 +939,93 @@ int main(int argc, char** argv)
   boost::shared_ptr<interactive_markers::InteractiveMarkerServer> server(
       new interactive_markers::InteractiveMarkerServer("selection") );
 
-  std::vector<tf::Vector3> points;
-  makePoints( points, 10000 );
+  // see SelectorOptions for the meaning of the parameters
+  ros::NodeHandle private_nh( "~" );
+  SelectorOptions options;
+  int num_threads;
+  private_nh.param( "live_preview", options.live_preview, false );
+  private_nh.param( "num_threads", num_threads, 0 );
+  private_nh.param( "mask_deltas", options.mask_deltas, false );
+  private_nh.param( "keyframe_interval", options.keyframe_interval, 100 );
+  private_nh.param( "max_marker_points", options.max_marker_points, 100000 );
+  private_nh.param( "update_rate", options.update_rate, 30.0 );
+  private_nh.param( "index_min_points", options.index_min_points, 1000000 );
+  options.num_threads = std::max( num_threads, 0 );
 
-  PointCouldSelector selector( server, points );
+  // ~point_file selects over a point file (see point_file.h) mapped into
+  // memory instead of generated points
+  std::string point_file;
+  private_nh.param( "point_file", point_file, std::string() );
 
-  // 'commit' changes and send to all clients
-  server->applyChanges();
+  // ~cloud_topic selects over the latest PointCloud2 received on that
+  // topic, expected in base_link
+  std::string cloud_topic;
+  private_nh.param( "cloud_topic", cloud_topic, std::string() );
 
-  // start the ROS main loop
-  ros::spin();
+  // ~quantize stores the generated points in 6 instead of 12 bytes each
+  bool quantize;
+  private_nh.param( "quantize", quantize, false );
+
+  if ( !cloud_topic.empty() )
+  {
+    // deltas refer to a fixed cloud
+    if ( options.mask_deltas )
+    {
+      ROS_WARN( "~mask_deltas is not supported with ~cloud_topic" );
+      options.mask_deltas = false;
+    }
+    runStream( server, cloud_topic, options );
+  }
+  else if ( !point_file.empty() )
+  {
+    boost::shared_ptr<MappedPointFile> points( new MappedPointFile );
+    if ( !points->open( point_file ) )
+    {
+      ROS_ERROR( "could not open point file %s: %s", point_file.c_str(), strerror( errno ) );
+      return 1;
+    }
+    ROS_INFO( "mapped %lu points from %s", (unsigned long)points->size(), point_file.c_str() );
+
+    // the published cloud would be a full copy of the file
+    if ( options.mask_deltas )
+    {
+      ROS_WARN( "~mask_deltas is not supported with ~point_file" );
+      options.mask_deltas = false;
+    }
+    if ( options.live_preview )
+    {
+      ROS_WARN( "~live_preview classifies the whole point file on every update" );
+    }
+    if ( options.max_marker_points == 0 )
+    {
+      ROS_WARN( "~max_marker_points can't be 0 with ~point_file, showing up to 100000 points" );
+      options.max_marker_points = 100000;
+    }
+    options.out_of_core = true;
+    run<MappedPointFile>( server, points, options );
+  }
+  else
+  {
+    std::vector<tf::Vector3> points;
+    makePoints( points, 10000 );
+
+    boost::shared_ptr<PointStore> store( new PointStore( points.size() ) );
+    for ( unsigned i=0; i<points.size(); i++ )
+    {
+      store->set( i, points[i].x(), points[i].y(), points[i].z() );
+    }
+    points.clear();
+
+    if ( quantize )
+    {
+      boost::shared_ptr<QuantizedPointStore> quantized( new QuantizedPointStore( *store ) );
+      store.reset();
+      run<QuantizedPointStore>( server, quantized, options );
+    }
+    else
+    {
+      run<PointStore>( server, store, options );
+    }
+  }
 }
 // %Tag(fullSource)%
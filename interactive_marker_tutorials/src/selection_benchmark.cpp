@@ -0,0 +1,695 @@
+/*
+ * Copyright (c) 2011, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Benchmarks of the selection tutorial: the selection pipeline (point
+// generation, box classification and marker construction, reported in
+// ns/point, allocations and peak RSS for 10k to 10M points) and the box
+// queries compared against a plain scan over all points.  Runs
+// standalone, no ROS master needed:
+//
+//   rosrun interactive_marker_tutorials selection_benchmark \
+//       --benchmark_filter='MakePoints|AabbKernel|UpdatePointCloud'
+
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <tf/LinearMath/Vector3.h>
+#include <visualization_msgs/InteractiveMarker.h>
+
+#include <interactive_marker_tutorials/marker_points.h>
+#include <interactive_marker_tutorials/parallel_classify.h>
+#include <interactive_marker_tutorials/point_cloud2_view.h>
+#include <interactive_marker_tutorials/point_decimation.h>
+#include <interactive_marker_tutorials/point_kd_tree.h>
+#include <interactive_marker_tutorials/point_store.h>
+#include <interactive_marker_tutorials/quantized_point_store.h>
+#include <interactive_marker_tutorials/selection_volume.h>
+#include <interactive_marker_tutorials/surface_points.h>
+#include <interactive_marker_tutorials/worker_pool.h>
+
+using interactive_marker_tutorials::Aabb;
+using interactive_marker_tutorials::AabbKernel;
+using interactive_marker_tutorials::OrientedBox;
+using interactive_marker_tutorials::PointCloud2View;
+using interactive_marker_tutorials::PointKdTree;
+using interactive_marker_tutorials::PointStore;
+using interactive_marker_tutorials::PolygonPrism;
+using interactive_marker_tutorials::QuantizedPointStore;
+using interactive_marker_tutorials::WorkerPool;
+
+namespace vm = visualization_msgs;
+
+// Every heap allocation is counted, so that benchmarks can report how
+// many they make per iteration.
+std::atomic<size_t> alloc_count( 0 );
+std::atomic<size_t> alloc_bytes( 0 );
+
+void* operator new( size_t size )
+{
+  alloc_count.fetch_add( 1, std::memory_order_relaxed );
+  alloc_bytes.fetch_add( size, std::memory_order_relaxed );
+  void* p = malloc( size ? size : 1 );
+  if ( !p )
+  {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete( void* p ) noexcept
+{
+  free( p );
+}
+
+void operator delete( void* p, size_t ) noexcept
+{
+  free( p );
+}
+
+namespace
+{
+
+// Tracks the allocations made while it is alive.
+class AllocationCounter
+{
+public:
+  AllocationCounter() : count_( alloc_count ), bytes_( alloc_bytes ) {}
+
+  size_t count() const { return alloc_count - count_; }
+  size_t bytes() const { return alloc_bytes - bytes_; }
+
+private:
+  size_t count_;
+  size_t bytes_;
+};
+
+// Peak resident set size of the process.  resetPeakRss() starts a new
+// peak at the current size (Linux only; elsewhere peaks only grow), so
+// a benchmark that resets it first reports the memory of its own data.
+void resetPeakRss()
+{
+#ifdef __GLIBC__
+  malloc_trim( 0 );
+#endif
+  FILE* file = fopen( "/proc/self/clear_refs", "w" );
+  if ( file )
+  {
+    fputs( "5", file );
+    fclose( file );
+  }
+}
+
+double peakRssMb()
+{
+  FILE* file = fopen( "/proc/self/status", "r" );
+  if ( !file )
+  {
+    return 0;
+  }
+  char line[256];
+  long kb = 0;
+  while ( fgets( line, sizeof( line ), file ) )
+  {
+    if ( sscanf( line, "VmHWM: %ld kB", &kb ) == 1 ) break;
+  }
+  fclose( file );
+  return kb / 1024.0;
+}
+
+// The counters of the selection pipeline benchmarks: time per point,
+// heap allocations per iteration and peak memory.  Create it right
+// before the benchmark loop, after the setup, so that the peak covers
+// the data the benchmark keeps and what the loop allocates.
+class PipelineCounters
+{
+public:
+  PipelineCounters()
+  {
+    resetPeakRss();
+    start_ = std::chrono::steady_clock::now();
+  }
+
+  void report( benchmark::State& state, size_t num_points ) const
+  {
+    double ns = std::chrono::duration<double, std::nano>( std::chrono::steady_clock::now() - start_ ).count();
+    state.counters["ns/point"] = ns / ( (double)state.iterations() * num_points );
+    state.counters["allocs"] = benchmark::Counter( allocations_.count(), benchmark::Counter::kAvgIterations );
+    state.counters["peak_rss_mb"] = peakRssMb();
+    state.SetItemsProcessed( state.iterations() * num_points );
+  }
+
+private:
+  AllocationCounter allocations_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+// Cloud sizes of the pipeline benchmarks.
+void pipelineSizes( benchmark::internal::Benchmark* b )
+{
+  b->Arg( 10000 )->Arg( 100000 )->Arg( 1000000 )->Arg( 10000000 );
+}
+
+class Vector3Cloud
+{
+public:
+  Vector3Cloud( const std::vector<tf::Vector3>& points ) : points_( points ) {}
+
+  size_t size() const { return points_.size(); }
+  float x( size_t i ) const { return points_[i].x(); }
+  float y( size_t i ) const { return points_[i].y(); }
+  float z( size_t i ) const { return points_[i].z(); }
+
+private:
+  const std::vector<tf::Vector3>& points_;
+};
+
+// Same distribution as makePoints() in selection.cpp, on a wider area
+// so that a fixed box only selects part of the cloud.
+void makeCloud( std::vector<tf::Vector3>& points, int num_points )
+{
+  srand( 42 );
+  points.resize( num_points );
+  for ( int i=0; i<num_points; i++ )
+  {
+    double x = 10.0 * rand() / RAND_MAX - 5.0;
+    double y = 10.0 * rand() / RAND_MAX - 5.0;
+    points[i] = tf::Vector3( x, y, 0.2 * ( sin( 3.0 * x ) + cos( 3.0 * y ) ) );
+  }
+}
+
+// The selection box covers about 4% of the cloud.
+const tf::Vector3 box_min( -1, -1, -1 );
+const tf::Vector3 box_max( 1, 1, 1 );
+
+// The selection pipeline: generating the points, classifying them and
+// building the point cloud markers, each with the counters of
+// PipelineCounters.
+
+void BM_MakePoints( benchmark::State& state )
+{
+  std::vector<tf::Vector3> points;
+
+  PipelineCounters counters;
+  for ( auto _ : state )
+  {
+    interactive_marker_tutorials::makePoints( points, state.range( 0 ) );
+    benchmark::DoNotOptimize( points.data() );
+  }
+  counters.report( state, points.size() );
+}
+
+void BM_LinearScan( benchmark::State& state )
+{
+  std::vector<tf::Vector3> points;
+  makeCloud( points, state.range( 0 ) );
+
+  std::vector<uint32_t> inside, outside;
+  for ( auto _ : state )
+  {
+    inside.clear();
+    outside.clear();
+    for ( uint32_t i=0; i<points.size(); i++ )
+    {
+      const tf::Vector3& p = points[i];
+      bool overlap = !( box_min.x() > p.x() || box_max.x() < p.x() ||
+                        box_min.y() > p.y() || box_max.y() < p.y() ||
+                        box_min.z() > p.z() || box_max.z() < p.z() );
+      ( overlap ? inside : outside ).push_back( i );
+    }
+    benchmark::DoNotOptimize( inside.data() );
+  }
+  state.SetItemsProcessed( state.iterations() * points.size() );
+}
+
+void BM_KdTreeBuild( benchmark::State& state )
+{
+  std::vector<tf::Vector3> points;
+  makeCloud( points, state.range( 0 ) );
+
+  for ( auto _ : state )
+  {
+    PointKdTree tree;
+    tree.build( Vector3Cloud( points ) );
+    benchmark::DoNotOptimize( tree.size() );
+  }
+  state.SetItemsProcessed( state.iterations() * points.size() );
+}
+
+void BM_KdTreeQuery( benchmark::State& state )
+{
+  std::vector<tf::Vector3> points;
+  makeCloud( points, state.range( 0 ) );
+  PointKdTree tree;
+  tree.build( Vector3Cloud( points ) );
+  Aabb box( box_min.x(), box_min.y(), box_min.z(), box_max.x(), box_max.y(), box_max.z() );
+
+  std::vector<uint32_t> inside;
+  for ( auto _ : state )
+  {
+    inside.clear();
+    tree.query( Vector3Cloud( points ), box, inside );
+    benchmark::DoNotOptimize( inside.data() );
+  }
+  state.SetItemsProcessed( state.iterations() * points.size() );
+}
+
+// Click picking as in point_cloud.cpp: the point closest to random
+// locations near the surface.
+void BM_KdTreeNearest( benchmark::State& state )
+{
+  std::vector<tf::Vector3> points;
+  makeCloud( points, state.range( 0 ) );
+  PointKdTree tree;
+  tree.build( Vector3Cloud( points ) );
+
+  uint32_t index = 0;
+  for ( auto _ : state )
+  {
+    float x = 10.0f * rand() / RAND_MAX - 5.0f;
+    float y = 10.0f * rand() / RAND_MAX - 5.0f;
+    tree.nearest( Vector3Cloud( points ), x, y, 0.0f, index );
+    benchmark::DoNotOptimize( index );
+  }
+}
+
+void BM_KdTreePartition( benchmark::State& state )
+{
+  std::vector<tf::Vector3> points;
+  makeCloud( points, state.range( 0 ) );
+  PointKdTree tree;
+  tree.build( Vector3Cloud( points ) );
+  Aabb box( box_min.x(), box_min.y(), box_min.z(), box_max.x(), box_max.y(), box_max.z() );
+
+  std::vector<uint32_t> inside, outside;
+  for ( auto _ : state )
+  {
+    inside.clear();
+    outside.clear();
+    tree.partition( Vector3Cloud( points ), box, inside, outside );
+    benchmark::DoNotOptimize( inside.data() );
+  }
+  state.SetItemsProcessed( state.iterations() * points.size() );
+}
+
+void makeStore( PointStore& store, int num_points )
+{
+  std::vector<tf::Vector3> points;
+  makeCloud( points, num_points );
+  store.resize( points.size() );
+  for ( size_t i=0; i<points.size(); i++ )
+  {
+    store.set( i, points[i].x(), points[i].y(), points[i].z() );
+  }
+}
+
+void BM_AabbKernel( benchmark::State& state )
+{
+  AabbKernel kernel = (AabbKernel)state.range( 1 );
+  if ( !interactive_marker_tutorials::aabbKernelSupported( kernel ) )
+  {
+    state.SkipWithError( "kernel not supported on this CPU" );
+    return;
+  }
+
+  PointStore store;
+  makeStore( store, state.range( 0 ) );
+  Aabb box( box_min.x(), box_min.y(), box_min.z(), box_max.x(), box_max.y(), box_max.z() );
+
+  std::vector<uint64_t> mask;
+  PipelineCounters counters;
+  for ( auto _ : state )
+  {
+    store.classify( box, mask, kernel );
+    benchmark::DoNotOptimize( mask.data() );
+  }
+  state.SetLabel( interactive_marker_tutorials::aabbKernelName( kernel ) );
+  counters.report( state, store.size() );
+}
+
+// The same classification on 16 bit quantized points.
+void BM_QuantizedClassify( benchmark::State& state )
+{
+  PointStore store;
+  makeStore( store, state.range( 0 ) );
+  QuantizedPointStore quantized( store );
+  Aabb box( box_min.x(), box_min.y(), box_min.z(), box_max.x(), box_max.y(), box_max.z() );
+
+  std::vector<uint64_t> mask( ( quantized.size() + 63 ) / 64 );
+  for ( auto _ : state )
+  {
+    quantized.classify( 0, quantized.size(), box, mask.data() );
+    benchmark::DoNotOptimize( mask.data() );
+  }
+  state.counters["bytes/point"] = 3 * sizeof( int16_t );
+  state.SetItemsProcessed( state.iterations() * quantized.size() );
+}
+
+// An oriented box and a concave prism of about the size of the test
+// box, for comparison with BM_AabbKernel.
+OrientedBox makeOrientedBox()
+{
+  return OrientedBox( 0, 0, 0, 2, 2, 2, 0.2, 0.1, 0.3, 0.9 );
+}
+
+PolygonPrism makePrism()
+{
+  PolygonPrism prism;
+  prism.addVertex( -1, -1 );
+  prism.addVertex( 1, -1 );
+  prism.addVertex( 0, 0 );
+  prism.addVertex( 1, 1 );
+  prism.addVertex( -1, 1 );
+  prism.addVertex( -1.2, 0 );
+  prism.min_z = -1;
+  prism.max_z = 1;
+  return prism;
+}
+
+// The test box, for comparison of BM_VolumeTree with BM_AabbKernel.
+interactive_marker_tutorials::AabbVolume makeAabbVolume()
+{
+  return interactive_marker_tutorials::AabbVolume(
+      Aabb( box_min.x(), box_min.y(), box_min.z(), box_max.x(), box_max.y(), box_max.z() ) );
+}
+
+// The volume kernels over all points, without culling.
+template<class Volume>
+void BM_VolumeKernel( benchmark::State& state, const Volume& volume )
+{
+  PointStore store;
+  makeStore( store, state.range( 0 ) );
+
+  std::vector<uint64_t> mask( ( store.size() + 63 ) / 64 );
+  for ( auto _ : state )
+  {
+    volume.classify( store.xData(), store.yData(), store.zData(), store.size(), mask.data() );
+    benchmark::DoNotOptimize( mask.data() );
+  }
+  state.SetItemsProcessed( state.iterations() * store.size() );
+}
+
+// The same through the k-d tree, as done by the selector.
+template<class Volume>
+void BM_VolumeTree( benchmark::State& state, const Volume& volume )
+{
+  PointStore store;
+  makeStore( store, state.range( 0 ) );
+  PointKdTree tree;
+  tree.build( store );
+
+  std::vector<uint64_t> mask( ( store.size() + 63 ) / 64 );
+  for ( auto _ : state )
+  {
+    tree.classify( store, volume, mask.data() );
+    benchmark::DoNotOptimize( mask.data() );
+  }
+  state.SetItemsProcessed( state.iterations() * store.size() );
+}
+
+// Classification plus the split into index lists, as done by the
+// selector, for a given number of threads.
+void BM_ParallelSelection( benchmark::State& state )
+{
+  PointStore store;
+  makeStore( store, state.range( 0 ) );
+  Aabb box( box_min.x(), box_min.y(), box_min.z(), box_max.x(), box_max.y(), box_max.z() );
+  WorkerPool pool( state.range( 1 ) );
+
+  std::vector<uint64_t> mask;
+  std::vector<uint32_t> inside, outside;
+  for ( auto _ : state )
+  {
+    interactive_marker_tutorials::classifyParallel( pool, store, box, mask );
+    interactive_marker_tutorials::splitByMask( pool, mask, store.size(), inside, outside );
+    benchmark::DoNotOptimize( outside.data() );
+  }
+  state.SetItemsProcessed( state.iterations() * store.size() );
+}
+
+// What the selector does per scan of a PointCloud2 stream with a tree
+// in use: wrap the message, rebuild the index and classify.  The cloud
+// has x, y, z and intensity, as most lidar drivers publish; at 20 Hz a
+// scan has 50 ms.
+void BM_PointCloud2Scan( benchmark::State& state )
+{
+  std::vector<tf::Vector3> points;
+  makeCloud( points, state.range( 0 ) );
+
+  sensor_msgs::PointCloud2Ptr cloud( new sensor_msgs::PointCloud2 );
+  const char* names[4] = { "x", "y", "z", "intensity" };
+  for ( int i=0; i<4; i++ )
+  {
+    sensor_msgs::PointField field;
+    field.name = names[i];
+    field.offset = i * sizeof( float );
+    field.datatype = sensor_msgs::PointField::FLOAT32;
+    field.count = 1;
+    cloud->fields.push_back( field );
+  }
+  cloud->height = 1;
+  cloud->width = points.size();
+  cloud->point_step = 4 * sizeof( float );
+  cloud->row_step = cloud->width * cloud->point_step;
+  cloud->data.resize( cloud->row_step );
+  float* data = reinterpret_cast<float*>( cloud->data.data() );
+  for ( size_t i=0; i<points.size(); i++ )
+  {
+    data[4 * i] = points[i].x();
+    data[4 * i + 1] = points[i].y();
+    data[4 * i + 2] = points[i].z();
+    data[4 * i + 3] = 1.0f;
+  }
+
+  Aabb box( box_min.x(), box_min.y(), box_min.z(), box_max.x(), box_max.y(), box_max.z() );
+  WorkerPool pool( 1 );
+  PointKdTree tree;
+  std::vector<uint64_t> mask;
+  for ( auto _ : state )
+  {
+    PointCloud2View view;
+    view.assign( cloud );
+    tree.build( view );
+    interactive_marker_tutorials::classifyParallel( pool, view, box, mask );
+    benchmark::DoNotOptimize( mask.data() );
+  }
+  state.SetItemsProcessed( state.iterations() * points.size() );
+}
+
+void kernelArgs( benchmark::internal::Benchmark* b )
+{
+  const int sizes[] = { 10000, 100000, 1000000, 10000000 };
+  for ( int kernel=interactive_marker_tutorials::AABB_KERNEL_SCALAR;
+        kernel<=interactive_marker_tutorials::AABB_KERNEL_AVX2; kernel++ )
+  {
+    for ( int i=0; i<4; i++ )
+    {
+      b->Args( { sizes[i], kernel } );
+    }
+  }
+}
+
+// Every other point of the cloud, as if half of it were selected.
+void makeSelection( std::vector<uint32_t>& indices, size_t num_points )
+{
+  indices.resize( num_points / 2 );
+  for ( size_t i=0; i<indices.size(); i++ )
+  {
+    indices[i] = 2 * i;
+  }
+}
+
+void reportAllocations( benchmark::State& state, const AllocationCounter& allocations, size_t num_points )
+{
+  state.counters["allocs/update"] = benchmark::Counter( allocations.count(), benchmark::Counter::kAvgIterations );
+  state.counters["alloc_bytes/update"] = benchmark::Counter( allocations.bytes(), benchmark::Counter::kAvgIterations );
+  state.counters["payload_bytes"] = num_points * sizeof( geometry_msgs::Point );
+}
+
+// Marker construction as selection.cpp used to do it: a fresh marker per
+// update, points appended one by one, then copied into the control, the
+// interactive marker and finally the server.
+void BM_MarkerRebuild( benchmark::State& state )
+{
+  PointStore store;
+  makeStore( store, state.range( 0 ) );
+  std::vector<uint32_t> indices;
+  makeSelection( indices, store.size() );
+  vm::InteractiveMarker server_copy;
+
+  AllocationCounter allocations;
+  for ( auto _ : state )
+  {
+    vm::InteractiveMarker int_marker;
+    vm::Marker points_marker;
+    for ( unsigned i=0; i<indices.size(); i++ )
+    {
+      geometry_msgs::Point p;
+      p.x = store.x( indices[i] );
+      p.y = store.y( indices[i] );
+      p.z = store.z( indices[i] );
+      points_marker.points.push_back( p );
+    }
+    vm::InteractiveMarkerControl points_control;
+    points_control.markers.push_back( points_marker );
+    int_marker.controls.push_back( points_control );
+    server_copy = int_marker;
+    benchmark::DoNotOptimize( server_copy.controls.data() );
+  }
+  reportAllocations( state, allocations, indices.size() );
+  state.SetItemsProcessed( state.iterations() * indices.size() );
+}
+
+// Marker construction as selection.cpp does it now: a persistent marker
+// whose points are overwritten in place before the copy into the server.
+void BM_MarkerInPlace( benchmark::State& state )
+{
+  PointStore store;
+  makeStore( store, state.range( 0 ) );
+  std::vector<uint32_t> indices;
+  makeSelection( indices, store.size() );
+  WorkerPool pool( 1 );
+  vm::InteractiveMarker server_copy;
+
+  vm::InteractiveMarker int_marker;
+  int_marker.controls.resize( 1 );
+  int_marker.controls[0].markers.resize( 1 );
+
+  AllocationCounter allocations;
+  for ( auto _ : state )
+  {
+    interactive_marker_tutorials::fillMarkerPoints( pool, store, indices,
+                                                    int_marker.controls[0].markers[0].points );
+    server_copy = int_marker;
+    benchmark::DoNotOptimize( server_copy.controls.data() );
+  }
+  reportAllocations( state, allocations, indices.size() );
+  state.SetItemsProcessed( state.iterations() * indices.size() );
+}
+
+// Both point cloud markers of a selection of half the cloud, built as
+// PointCouldSelector::updatePointCloud() does, including the copy the
+// server makes.  Clouds beyond the default marker budget are decimated.
+void BM_UpdatePointCloud( benchmark::State& state )
+{
+  PointStore store;
+  makeStore( store, state.range( 0 ) );
+  std::vector<uint32_t> inside, outside;
+  for ( uint32_t i=0; i<store.size(); i++ )
+  {
+    ( i % 2 ? outside : inside ).push_back( i );
+  }
+  WorkerPool pool( 1 );
+  std::vector<uint32_t> decimated;
+  vm::InteractiveMarker server_copy;
+
+  vm::InteractiveMarker markers[2];
+  for ( int i=0; i<2; i++ )
+  {
+    markers[i].controls.resize( 1 );
+    markers[i].controls[0].markers.resize( 1 );
+  }
+
+  PipelineCounters counters;
+  for ( auto _ : state )
+  {
+    for ( int i=0; i<2; i++ )
+    {
+      interactive_marker_tutorials::updatePointMarker( pool, store, i ? outside : inside, 100000,
+                                                       decimated, markers[i].controls[0].markers[0] );
+      server_copy = markers[i];
+      benchmark::DoNotOptimize( server_copy.controls.data() );
+    }
+  }
+  counters.report( state, store.size() );
+}
+
+// Display decimation of the whole cloud to the default marker budget.
+// Reports how many points reach the marker and the size of their part
+// of the marker message; RViz frame rates follow the marker point count
+// and have to be measured in RViz itself.
+void BM_VoxelDecimate( benchmark::State& state )
+{
+  PointStore store;
+  makeStore( store, state.range( 0 ) );
+  std::vector<uint32_t> indices( store.size() );
+  for ( size_t i=0; i<indices.size(); i++ )
+  {
+    indices[i] = i;
+  }
+
+  std::vector<uint32_t> decimated;
+  float cell = 0.0f;
+  for ( auto _ : state )
+  {
+    cell = interactive_marker_tutorials::decimateVoxelGrid( store, indices, 100000, decimated );
+    benchmark::DoNotOptimize( decimated.data() );
+  }
+  size_t shown = cell > 0 ? decimated.size() : indices.size();
+  state.counters["marker_points"] = shown;
+  state.counters["marker_bytes"] = shown * sizeof( geometry_msgs::Point );
+  state.counters["full_bytes"] = indices.size() * sizeof( geometry_msgs::Point );
+  state.counters["cell"] = cell;
+  state.SetItemsProcessed( state.iterations() * store.size() );
+}
+
+} // namespace
+
+BENCHMARK( BM_MakePoints )->Apply( pipelineSizes )->Unit( benchmark::kMillisecond );
+BENCHMARK( BM_UpdatePointCloud )->Apply( pipelineSizes )->Unit( benchmark::kMillisecond );
+BENCHMARK( BM_LinearScan )->Arg( 10000 )->Arg( 1000000 )->Arg( 10000000 )->Unit( benchmark::kMillisecond );
+BENCHMARK( BM_KdTreeBuild )->Arg( 10000 )->Arg( 1000000 )->Arg( 10000000 )->Unit( benchmark::kMillisecond );
+BENCHMARK( BM_KdTreeQuery )->Arg( 10000 )->Arg( 1000000 )->Arg( 10000000 )->Unit( benchmark::kMillisecond );
+BENCHMARK( BM_KdTreeNearest )->Arg( 10000 )->Arg( 1000000 )->Arg( 10000000 )->Unit( benchmark::kMicrosecond );
+BENCHMARK( BM_KdTreePartition )->Arg( 10000 )->Arg( 1000000 )->Arg( 10000000 )->Unit( benchmark::kMillisecond );
+BENCHMARK( BM_AabbKernel )->Apply( kernelArgs )->Unit( benchmark::kMillisecond );
+BENCHMARK_CAPTURE( BM_VolumeKernel, oriented_box, makeOrientedBox() )->Arg( 1000000 )->Arg( 10000000 )->Unit( benchmark::kMillisecond );
+BENCHMARK_CAPTURE( BM_VolumeKernel, prism, makePrism() )->Arg( 1000000 )->Arg( 10000000 )->Unit( benchmark::kMillisecond );
+BENCHMARK_CAPTURE( BM_VolumeTree, aabb, makeAabbVolume() )->Arg( 1000000 )->Arg( 10000000 )->Unit( benchmark::kMillisecond );
+BENCHMARK_CAPTURE( BM_VolumeTree, oriented_box, makeOrientedBox() )->Arg( 1000000 )->Arg( 10000000 )->Unit( benchmark::kMillisecond );
+BENCHMARK_CAPTURE( BM_VolumeTree, prism, makePrism() )->Arg( 1000000 )->Arg( 10000000 )->Unit( benchmark::kMillisecond );
+BENCHMARK( BM_QuantizedClassify )->Arg( 10000 )->Arg( 1000000 )->Arg( 10000000 )->Unit( benchmark::kMillisecond );
+BENCHMARK( BM_ParallelSelection )
+    ->ArgPair( 8000000, 1 )->ArgPair( 8000000, 2 )->ArgPair( 8000000, 4 )
+    ->ArgPair( 8000000, 8 )->ArgPair( 8000000, 16 )
+    ->UseRealTime()->Unit( benchmark::kMillisecond );
+BENCHMARK( BM_PointCloud2Scan )->Arg( 30000 )->Arg( 100000 )->Arg( 300000 )->Arg( 1000000 )->Unit( benchmark::kMillisecond );
+BENCHMARK( BM_MarkerRebuild )->Arg( 10000 )->Arg( 1000000 )->Unit( benchmark::kMillisecond );
+BENCHMARK( BM_MarkerInPlace )->Arg( 10000 )->Arg( 1000000 )->Unit( benchmark::kMillisecond );
+BENCHMARK( BM_VoxelDecimate )->Arg( 10000 )->Arg( 100000 )->Arg( 1000000 )->Arg( 10000000 )->Unit( benchmark::kMillisecond );
+
+BENCHMARK_MAIN();
@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2011, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+// Counterpart of the selection tutorial when run with ~mask_deltas set.
+// Receives the points once and then only SelectionDelta messages, keeps
+// its own copy of the selection up to date and republishes the selected
+// points as a local point cloud.
+
+#include <ros/ros.h>
+
+#include <sensor_msgs/PointCloud2.h>
+
+#include <interactive_marker_tutorials/SelectionDelta.h>
+#include <interactive_marker_tutorials/selection_mask.h>
+
+class SelectionClient
+{
+public:
+  SelectionClient() :
+    nh_( "selection" ),
+    have_state_( false ),
+    sequence_( 0 ),
+    num_points_( 0 )
+  {
+    points_sub_ = nh_.subscribe( "points", 1, &SelectionClient::pointsCallback, this );
+    delta_sub_ = nh_.subscribe( "delta", 100, &SelectionClient::deltaCallback, this );
+    selected_pub_ = nh_.advertise<sensor_msgs::PointCloud2>( "selected_cloud", 1, true );
+  }
+
+  void pointsCallback( const sensor_msgs::PointCloud2ConstPtr& points )
+  {
+    points_ = points;
+    publishSelected();
+  }
+
+  void deltaCallback( const interactive_marker_tutorials::SelectionDeltaConstPtr& msg )
+  {
+    if ( !msg->mask.empty() )
+    {
+      interactive_marker_tutorials::unpackMask( msg->mask, msg->num_points, mask_ );
+      num_points_ = msg->num_points;
+      have_state_ = true;
+    }
+    else if ( !have_state_ || msg->sequence <= sequence_ )
+    {
+      // nothing to apply this to yet, or already part of our state
+      return;
+    }
+    else if ( msg->sequence != sequence_ + 1 || msg->num_points != num_points_ )
+    {
+      ROS_WARN( "missed a selection update before %u, waiting for the next keyframe", msg->sequence );
+      have_state_ = false;
+      return;
+    }
+    else
+    {
+      interactive_marker_tutorials::applyDelta( mask_, msg->toggled );
+    }
+    sequence_ = msg->sequence;
+
+    ROS_DEBUG( "selection update %u: %lu bytes", sequence_,
+               (unsigned long)( msg->mask.size() + 4 * msg->toggled.size() ) );
+    publishSelected();
+  }
+
+private:
+  // Copy the selected points, whatever their fields are, into a new cloud.
+  void publishSelected()
+  {
+    if ( !points_ || !have_state_ || points_->width * points_->height != num_points_ )
+    {
+      return;
+    }
+
+    sensor_msgs::PointCloud2 selected;
+    selected.header = points_->header;
+    selected.fields = points_->fields;
+    selected.is_bigendian = points_->is_bigendian;
+    selected.point_step = points_->point_step;
+    selected.is_dense = points_->is_dense;
+    selected.height = 1;
+
+    size_t count = 0;
+    for ( size_t w=0; w<mask_.size(); w++ )
+    {
+      count += __builtin_popcountll( mask_[w] );
+    }
+    selected.width = count;
+    selected.row_step = selected.point_step * count;
+    selected.data.resize( selected.row_step );
+
+    uint8_t* out = selected.data.data();
+    for ( size_t w=0; w<mask_.size(); w++ )
+    {
+      uint64_t bits = mask_[w];
+      while ( bits )
+      {
+        size_t i = w * 64 + __builtin_ctzll( bits );
+        const uint8_t* in = &points_->data[( i / points_->width ) * points_->row_step +
+                                           ( i % points_->width ) * points_->point_step];
+        std::copy( in, in + points_->point_step, out );
+        out += points_->point_step;
+        bits &= bits - 1;
+      }
+    }
+
+    selected_pub_.publish( selected );
+  }
+
+  ros::NodeHandle nh_;
+  ros::Subscriber points_sub_;
+  ros::Subscriber delta_sub_;
+  ros::Publisher selected_pub_;
+
+  sensor_msgs::PointCloud2ConstPtr points_;
+
+  bool have_state_;
+  uint32_t sequence_;
+  uint32_t num_points_;
+  std::vector<uint64_t> mask_;
+};
+
+int main(int argc, char** argv)
+{
+  ros::init(argc, argv, "selection_client");
+
+  SelectionClient client;
+
+  ros::spin();
+}
@@ -0,0 +1,248 @@
+/*
+ * Copyright (c) 2011, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <visualization_msgs/Marker.h>
+
+#include <interactive_marker_tutorials/aabb_kernel.h>
+#include <interactive_marker_tutorials/marker_points.h>
+#include <interactive_marker_tutorials/point_decimation.h>
+#include <interactive_marker_tutorials/point_kd_tree.h>
+#include <interactive_marker_tutorials/point_store.h>
+
+using interactive_marker_tutorials::Aabb;
+using interactive_marker_tutorials::AabbVolume;
+using interactive_marker_tutorials::PointKdTree;
+using interactive_marker_tutorials::PointStore;
+
+namespace
+{
+
+// Points spread over [-5, 5]^2 x [-1, 1], with one in every_nan of them
+// invalid the way organized lidar clouds mark missing returns.
+void makeCloud( PointStore& store, size_t num_points, size_t every_nan )
+{
+  srand( 7 );
+  store.resize( num_points );
+  for ( size_t i=0; i<num_points; i++ )
+  {
+    float x = 10.0 * rand() / RAND_MAX - 5.0;
+    float y = 10.0 * rand() / RAND_MAX - 5.0;
+    float z = 2.0 * rand() / RAND_MAX - 1.0;
+    if ( every_nan > 0 && i % every_nan == 3 )
+    {
+      // mostly all of x, y and z, sometimes just one of them
+      x = NAN;
+      if ( i % 2 ) y = z = NAN;
+    }
+    store.set( i, x, y, z );
+  }
+}
+
+std::vector<uint32_t> scan( const PointStore& store, const Aabb& box )
+{
+  std::vector<uint32_t> inside;
+  for ( uint32_t i=0; i<store.size(); i++ )
+  {
+    if ( box.contains( store.x( i ), store.y( i ), store.z( i ) ) )
+    {
+      inside.push_back( i );
+    }
+  }
+  return inside;
+}
+
+const Aabb test_box( -1, -1, -0.5, 1.5, 1, 0.5 );
+
+} // namespace
+
+TEST( PointKdTree, QueryMatchesScanWithNaN )
+{
+  PointStore store;
+  makeCloud( store, 100000, 7 );
+  PointKdTree tree;
+  tree.build( store );
+
+  std::vector<uint32_t> inside;
+  tree.query( store, test_box, inside );
+  std::sort( inside.begin(), inside.end() );
+  EXPECT_EQ( scan( store, test_box ), inside );
+}
+
+TEST( PointKdTree, PartitionCoversAllPointsWithNaN )
+{
+  PointStore store;
+  makeCloud( store, 100000, 7 );
+  PointKdTree tree;
+  tree.build( store );
+
+  std::vector<uint32_t> inside, outside;
+  tree.partition( store, test_box, inside, outside );
+  std::sort( inside.begin(), inside.end() );
+  EXPECT_EQ( scan( store, test_box ), inside );
+  EXPECT_EQ( store.size(), inside.size() + outside.size() );
+  for ( size_t i=0; i<outside.size(); i++ )
+  {
+    EXPECT_FALSE( std::binary_search( inside.begin(), inside.end(), outside[i] ) );
+  }
+}
+
+TEST( PointKdTree, ClassifyMatchesScanWithNaN )
+{
+  PointStore store;
+  makeCloud( store, 100000, 7 );
+  PointKdTree tree;
+  tree.build( store );
+
+  std::vector<uint64_t> mask( ( store.size() + 63 ) / 64 );
+  tree.classify( store, AabbVolume( test_box ), mask.data() );
+
+  std::vector<uint64_t> expected( mask.size(), 0 );
+  std::vector<uint32_t> inside = scan( store, test_box );
+  for ( size_t i=0; i<inside.size(); i++ )
+  {
+    expected[inside[i] / 64] |= (uint64_t)1 << ( inside[i] % 64 );
+  }
+  EXPECT_EQ( expected, mask );
+}
+
+TEST( PointKdTree, NearestIgnoresNaN )
+{
+  PointStore store;
+  makeCloud( store, 10000, 7 );
+  PointKdTree tree;
+  tree.build( store );
+
+  uint32_t index;
+  ASSERT_TRUE( tree.nearest( store, 0.5, 0.5, 0, index ) );
+  EXPECT_TRUE( isfinite( store.x( index ) ) );
+
+  float best = INFINITY;
+  for ( uint32_t i=0; i<store.size(); i++ )
+  {
+    float dx = store.x( i ) - 0.5, dy = store.y( i ) - 0.5, dz = store.z( i );
+    float d = dx * dx + dy * dy + dz * dz;
+    if ( d < best ) best = d;
+  }
+  float dx = store.x( index ) - 0.5, dy = store.y( index ) - 0.5, dz = store.z( index );
+  EXPECT_EQ( best, dx * dx + dy * dy + dz * dz );
+}
+
+TEST( PointKdTree, AllNaN )
+{
+  PointStore store;
+  makeCloud( store, 1000, 1 );
+  for ( uint32_t i=0; i<store.size(); i++ )
+  {
+    store.set( i, NAN, NAN, NAN );
+  }
+  PointKdTree tree;
+  tree.build( store );
+  EXPECT_EQ( 0u, tree.size() );
+
+  std::vector<uint32_t> inside, outside;
+  tree.partition( store, test_box, inside, outside );
+  EXPECT_TRUE( inside.empty() );
+  EXPECT_EQ( store.size(), outside.size() );
+
+  uint32_t index;
+  EXPECT_FALSE( tree.nearest( store, 0, 0, 0, index ) );
+}
+
+TEST( DecimateVoxelGrid, DropsNaN )
+{
+  PointStore store;
+  makeCloud( store, 100000, 7 );
+  std::vector<uint32_t> indices( store.size() );
+  for ( uint32_t i=0; i<indices.size(); i++ )
+  {
+    indices[i] = i;
+  }
+
+  std::vector<uint32_t> decimated;
+  float cell = interactive_marker_tutorials::decimateVoxelGrid( store, indices, 1000, decimated );
+  EXPECT_GT( cell, 0.0f );
+  EXPECT_FALSE( decimated.empty() );
+  EXPECT_LE( decimated.size(), 1000u );
+  for ( size_t i=0; i<decimated.size(); i++ )
+  {
+    EXPECT_TRUE( interactive_marker_tutorials::isFinitePoint( store, decimated[i] ) );
+  }
+}
+
+// A subset within the budget isn't decimated, but its NaN points must
+// still stay out of the marker.
+TEST( UpdatePointMarker, DropsNaNWithoutDecimation )
+{
+  PointStore store;
+  makeCloud( store, 100, 7 );
+  std::vector<uint32_t> indices( store.size() );
+  for ( uint32_t i=0; i<indices.size(); i++ )
+  {
+    indices[i] = i;
+  }
+
+  interactive_marker_tutorials::WorkerPool pool( 1 );
+  std::vector<uint32_t> decimated;
+  visualization_msgs::Marker marker;
+  interactive_marker_tutorials::updatePointMarker( pool, store, indices, 1000, decimated, marker );
+  size_t num_nan = 0;
+  for ( uint32_t i=0; i<store.size(); i++ )
+  {
+    num_nan += interactive_marker_tutorials::isFinitePoint( store, i ) ? 0 : 1;
+  }
+  EXPECT_GT( num_nan, 0u );
+  EXPECT_EQ( store.size() - num_nan, marker.points.size() );
+  for ( size_t i=0; i<marker.points.size(); i++ )
+  {
+    EXPECT_TRUE( std::isfinite( marker.points[i].x ) );
+    EXPECT_TRUE( std::isfinite( marker.points[i].y ) );
+    EXPECT_TRUE( std::isfinite( marker.points[i].z ) );
+  }
+
+  // all finite: the indices are shown as given
+  std::vector<uint32_t> finite;
+  ASSERT_TRUE( interactive_marker_tutorials::dropNonFinite( store, indices, finite ) );
+  EXPECT_FALSE( interactive_marker_tutorials::dropNonFinite( store, finite, decimated ) );
+  interactive_marker_tutorials::updatePointMarker( pool, store, finite, 1000, decimated, marker );
+  EXPECT_EQ( finite.size(), marker.points.size() );
+}
+
+int main( int argc, char** argv )
+{
+  testing::InitGoogleTest( &argc, argv );
+  return RUN_ALL_TESTS();
+}